@@ -1,9 +1,56 @@
 #include <iostream>
 #include <string>    // For std::string, std::to_string
 #include <sstream>   // For std::stringstream
+#include <vector>    // For std::vector (NodePool block list)
+#include <new>       // For placement new
+#include <cstdint>   // For uint32_t (FlatQuadTree child indices)
+#include <atomic>    // For std::atomic (thread-safe node IDs)
+#include <thread>    // For std::thread (ParallelBuilder workers)
+#include <mutex>     // For std::mutex
+#include <condition_variable> // For std::condition_variable
+#include <deque>     // For the ParallelBuilder task queue
+#include <queue>     // For std::priority_queue (k-NN best-first search)
+#include <unordered_map> // For the query-result cache
+#include <memory>    // For std::unique_ptr (per-worker pools)
+#include <fstream>   // For std::ofstream (binary snapshot writer)
+#include <sys/mman.h> // For mmap/munmap (zero-copy snapshot load)
+#include <sys/stat.h> // For fstat
+#include <fcntl.h>    // For open
+#include <unistd.h>   // For close
+#include <algorithm> // For std::partition (bulk-load quadrant split)
+#include <type_traits> // For std::is_trivially_destructible (pooled payloads)
+#include <chrono>     // For benchmark timing
+#include <cstring>    // For strcmp (command-line flags)
+#include <cstdlib>    // For std::abort (reader slot exhaustion)
+#include <sys/resource.h> // For getrusage (peak RSS reporting)
+#ifdef __SSE2__
+#include <emmintrin.h> // For the vectorized quadrant classifier
+#endif
 
-// Forward declaration for the QuadTree class
-class QuadTree;
+// --- Payload Support ---
+// Trees can carry a per-region payload of type PayloadT inline in every
+// node, right next to the box it annotates — no side unordered_map keyed
+// on node IDs, no extra cache miss to reach the data. The default is
+// NoPayload, which occupies zero bytes.
+struct NoPayload {};
+
+// Storage slot for the inline payload. The NoPayload specialization is
+// empty, so payload-free trees pay nothing for the feature (empty-base
+// optimization keeps the node layout identical to what it was before
+// payloads existed).
+template <typename PayloadT>
+struct PayloadSlot {
+    PayloadT _payload{};
+};
+template <>
+struct PayloadSlot<NoPayload> {};
+
+// Forward declarations; QuadTree and NodePool are the payload-free
+// instantiations, which is what most of this file (and main) works with.
+template <typename PayloadT = NoPayload> class BasicQuadTree;
+template <typename PayloadT = NoPayload> class BasicNodePool;
+using QuadTree = BasicQuadTree<>;
+using NodePool = BasicNodePool<>;
 
 // --- Point Structure ---
 // Represents a 2D coordinate for the top-left corner of a node.
@@ -20,12 +67,336 @@ struct Point {
     }
 };
 
+// --- NodePool (Arena Allocator) ---
+// Hands out QuadTree nodes from large contiguous blocks instead of one
+// `new` per node. Building a tree from a pool costs a handful of big
+// allocations, and tearing it down is a single sweep over the blocks in
+// ~NodePool() — no recursive per-node `delete` traffic.
+//
+// Blocks are mmap'd in 2MB huge-page-aligned chunks with MADV_HUGEPAGE,
+// so deep traversals over a big arena stop thrashing the TLB. The pages
+// are untouched until a node is constructed in them, which makes NUMA
+// placement a first-touch property: give each worker thread its own pool
+// (as ParallelBuilder does) and every block lands on the memory node of
+// the thread that fills — and later serves — that quadrant.
+//
+// Nodes obtained from a pool must never be deleted individually; their
+// storage lives and dies with the pool.
+template <typename PayloadT>
+class BasicNodePool {
+public:
+    // A pool hands out nodes of exactly one payload instantiation; the
+    // alias keeps the member signatures reading like the concrete case.
+    using QuadTree = BasicQuadTree<PayloadT>;
+
+    // Blocks are sized in multiples of this (the x86-64 huge page).
+    static const size_t HUGE_PAGE_BYTES = size_t(2) << 20;
+
+    // blockCapacity is the minimum number of nodes per block; actual
+    // blocks round up to whole huge pages and use all of the space.
+    explicit BasicNodePool(size_t blockCapacity = 4096)
+        : _blockCapacity(blockCapacity), _allocatedNodes(0) {}
+
+    // Unmaps every block wholesale. QuadTree nodes are trivially
+    // destructible as far as the pool is concerned (children are pool
+    // storage too), so no per-node destructor calls are needed.
+    ~BasicNodePool() {
+        for (const Block& block : _blocks) {
+            munmap(block.memory, block.bytes);
+        }
+    }
+
+    // Pools own their storage exclusively; copying would double-free.
+    BasicNodePool(const BasicNodePool&) = delete;
+    BasicNodePool& operator=(const BasicNodePool&) = delete;
+
+    // Constructs a QuadTree node in the current block (placement new),
+    // starting a new block when the current one is full. Recycled slots
+    // are reused before fresh block space. The node's ID comes from this
+    // pool's private ID range (see takeId), not the shared counter.
+    QuadTree* allocate(Point pos, int width, int height);
+
+    // Returns a node's slot to the pool for reuse by a later allocate().
+    // Only for nodes this pool handed out; the storage is not freed, just
+    // made available again (incremental updates rebuild subtrees without
+    // growing the arena).
+    void recycle(QuadTree* node) { _freeList.push_back(node); }
+
+    // Number of nodes handed out so far.
+    size_t allocatedNodes() const { return _allocatedNodes; }
+
+private:
+    // One mapped storage chunk.
+    struct Block {
+        char* memory;
+        size_t bytes;
+    };
+
+    // IDs reserved from the shared counter per refill. Large enough that
+    // a parallel build touches the shared cache line once per thousand
+    // nodes instead of once per node.
+    static const int ID_BLOCK = 1024;
+
+    // Hands out the next ID from this pool's reserved range, refilling
+    // the range from the shared QuadTree counter when it runs dry. Not
+    // thread-safe — but pools are single-owner by design (one per
+    // ParallelBuilder worker), so no two threads share a range.
+    int takeId();
+
+    std::vector<Block> _blocks; // Raw storage blocks, unmapped in bulk
+    std::vector<QuadTree*> _freeList; // Recycled slots, reused first
+    size_t _blockCapacity;      // Nodes per block (after huge-page rounding)
+    size_t _usedInBlock = 0;    // Nodes carved out of the last block
+    size_t _allocatedNodes;
+    int _nextLocalId = 0;       // Next ID in the reserved range
+    int _idsLeft = 0;           // IDs remaining before a refill
+};
+
+// --- Trace Facility ---
+// Diagnostics for the build/teardown paths. Silent by default: the hot
+// loops pay one well-predicted integer compare per message site, and
+// compiling with -DQUADTREE_NO_TRACE removes even that. Output goes to a
+// buffered sink (std::clog by default, redirectable via setSink) so an
+// enabled trace doesn't serialize the tree build behind console flushes.
+namespace trace {
+
+// 0 = silent, 1 = structural events (leaf floors), 2 = per-node lifecycle.
+int level = 0;
+
+// Current sink; std::clog is buffered, unlike std::cout's tied/flushed
+// behavior, so even verbose runs batch their writes.
+std::ostream* sinkStream = &std::clog;
+
+inline std::ostream& sink() { return *sinkStream; }
+inline void setSink(std::ostream& out) { sinkStream = &out; }
+
+} // namespace trace
+
+#ifdef QUADTREE_NO_TRACE
+// Tracing compiled out: message sites vanish entirely.
+#define QT_TRACE(requiredLevel, message) ((void)0)
+#else
+#define QT_TRACE(requiredLevel, message)                         \
+    do {                                                         \
+        if (trace::level >= (requiredLevel)) {                   \
+            trace::sink() << message << '\n';                    \
+        }                                                        \
+    } while (0)
+#endif
+
+// --- Instrumentation Counters ---
+// Cheap per-operation counters for production monitoring, compiled in
+// with -DQUADTREE_COUNTERS and costing nothing otherwise. Query visit
+// and prune counts are the shape-degradation signal: when visits per
+// query creep up while prunes fall, the tree has degraded and a rebuild
+// is worth scheduling.
+namespace counters {
+
+#ifdef QUADTREE_COUNTERS
+std::atomic<uint64_t> nodesCreated{0};  // QuadTree(Point,int,int) runs
+std::atomic<uint64_t> subdivisions{0};  // createChildren() runs
+std::atomic<uint64_t> queryVisits{0};   // Nodes visited by query engines
+std::atomic<uint64_t> pruneHits{0};     // Subtrees skipped by pruning
+
+#define QT_COUNT(counter) (++counters::counter)
+
+// Dumps the counters; call wherever monitoring scrapes live.
+inline void report(std::ostream& out) {
+    out << "counters: nodesCreated=" << nodesCreated.load()
+        << ", subdivisions=" << subdivisions.load()
+        << ", queryVisits=" << queryVisits.load()
+        << ", pruneHits=" << pruneHits.load() << '\n';
+}
+#else
+#define QT_COUNT(counter) ((void)0)
+
+inline void report(std::ostream& out) {
+    out << "counters: disabled (compile with -DQUADTREE_COUNTERS)\n";
+}
+#endif
+
+} // namespace counters
+
+// --- Tree Statistics ---
+// Snapshot of a tree's shape and footprint, produced by QuadTree::stats().
+struct TreeStats {
+    size_t nodeCount = 0;
+    size_t leafCount = 0;
+    size_t pointCount = 0;
+    int maxDepth = 0;
+    std::vector<size_t> depthHistogram; // Nodes per depth level
+    size_t memoryBytes = 0;             // Node storage only
+
+    // Prints the report in the same register as the benchmark output.
+    void print(std::ostream& out) const {
+        out << "nodes=" << nodeCount << " (" << leafCount << " leaves), points="
+            << pointCount << ", maxDepth=" << maxDepth
+            << ", memory=" << memoryBytes << " bytes\n";
+        out << "depth histogram:";
+        for (size_t d = 0; d < depthHistogram.size(); ++d) {
+            out << " " << d << ":" << depthHistogram[d];
+        }
+        out << '\n';
+    }
+};
+
+// --- Batch Quadrant Classification ---
+// Routes whole batches of points to child quadrants at once. Input is
+// structure-of-arrays (separate x[] and y[]) so the vector loads are
+// contiguous; output is one quadrant index per point, using the same
+// numbering as the sibling order everywhere else in this file:
+// 0 = NW, 1 = NE, 2 = SW, 3 = SE.
+namespace simd {
+
+// Plain scalar classifier; also serves as the tail/fallback path.
+inline void classifyQuadrantsScalar(const int32_t* x, const int32_t* y, size_t count,
+                                    int32_t midX, int32_t midY, uint8_t* out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<uint8_t>((x[i] >= midX ? 1 : 0) | (y[i] >= midY ? 2 : 0));
+    }
+}
+
+// Classifies `count` points against a node's center (midX, midY).
+// With SSE2, sixteen points are handled per iteration: the east bit is
+// (x >= midX) and the south bit (y >= midY), combined as east | south<<1,
+// then four lanes' worth of 32-bit results are packed down to one byte
+// store. Builds without SSE2 get the scalar loop.
+inline void classifyQuadrants(const int32_t* x, const int32_t* y, size_t count,
+                              int32_t midX, int32_t midY, uint8_t* out) {
+#ifdef __SSE2__
+    const __m128i vMidX = _mm_set1_epi32(midX);
+    const __m128i vMidY = _mm_set1_epi32(midY);
+    const __m128i vOne = _mm_set1_epi32(1);
+
+    // One group of four points -> four quadrant indices as 32-bit lanes.
+    // cmplt yields -1 for west/north lanes; adding 1 turns that into
+    // 0 (west) / 1 (east) without any branch.
+    auto classify4 = [&](size_t i) {
+        __m128i vx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+        __m128i vy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i));
+        __m128i eastBit = _mm_add_epi32(_mm_cmplt_epi32(vx, vMidX), vOne);
+        __m128i southBit = _mm_add_epi32(_mm_cmplt_epi32(vy, vMidY), vOne);
+        return _mm_or_si128(eastBit, _mm_slli_epi32(southBit, 1));
+    };
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // Narrow 16 x 32-bit indices (all in 0..3, so packing saturates
+        // nothing) into a single 16-byte store.
+        __m128i words01 = _mm_packs_epi32(classify4(i), classify4(i + 4));
+        __m128i words23 = _mm_packs_epi32(classify4(i + 8), classify4(i + 12));
+        __m128i bytes = _mm_packus_epi16(words01, words23);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bytes);
+    }
+    classifyQuadrantsScalar(x + i, y + i, count - i, midX, midY, out + i);
+#else
+    classifyQuadrantsScalar(x, y, count, midX, midY, out);
+#endif
+}
+
+// Scalar classifier for interleaved Point records (array-of-structures);
+// also the tail/fallback path of classifyPoints.
+inline void classifyPointsScalar(const Point* pts, size_t count,
+                                 int32_t midX, int32_t midY, uint8_t* out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<uint8_t>((pts[i].x >= midX ? 1 : 0) |
+                                      (pts[i].y >= midY ? 2 : 0));
+    }
+}
+
+// Classifies interleaved Point records without deinterleaving them into
+// separate arrays first — the ingestion pipeline runs this straight over
+// a memory-mapped file. Two vector loads cover four points; a pair of
+// shuffles splits them into x and y lanes, after which the bit math and
+// 16-point packing match classifyQuadrants exactly.
+inline void classifyPoints(const Point* pts, size_t count,
+                           int32_t midX, int32_t midY, uint8_t* out) {
+#ifdef __SSE2__
+    const __m128i vMidX = _mm_set1_epi32(midX);
+    const __m128i vMidY = _mm_set1_epi32(midY);
+    const __m128i vOne = _mm_set1_epi32(1);
+
+    auto classify4 = [&](size_t i) {
+        // a = x0 y0 x1 y1, b = x2 y2 x3 y3
+        __m128 a = _mm_castsi128_ps(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(pts + i)));
+        __m128 b = _mm_castsi128_ps(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(pts + i + 2)));
+        __m128i vx = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i vy = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128i eastBit = _mm_add_epi32(_mm_cmplt_epi32(vx, vMidX), vOne);
+        __m128i southBit = _mm_add_epi32(_mm_cmplt_epi32(vy, vMidY), vOne);
+        return _mm_or_si128(eastBit, _mm_slli_epi32(southBit, 1));
+    };
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i words01 = _mm_packs_epi32(classify4(i), classify4(i + 4));
+        __m128i words23 = _mm_packs_epi32(classify4(i + 8), classify4(i + 12));
+        __m128i bytes = _mm_packus_epi16(words01, words23);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bytes);
+    }
+    classifyPointsScalar(pts + i, count - i, midX, midY, out + i);
+#else
+    classifyPointsScalar(pts, count, midX, midY, out);
+#endif
+}
+
+} // namespace simd
+
+// --- Morton (Z-Order) Encoding ---
+// Bit-interleaving helpers shared by the linear quadtree, the static
+// tree's leaf addressing, and the batched-query planner.
+namespace morton {
+
+// Spreads the 16 bits of v out to even bit positions (0b...b1b1b0).
+inline uint32_t part1By1(uint32_t v) {
+    v &= 0x0000FFFFu;
+    v = (v | (v << 8)) & 0x00FF00FFu;
+    v = (v | (v << 4)) & 0x0F0F0F0Fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+// Interleaves x and y (16 bits each, so regions up to 65536 square) into
+// a Morton code. Codes are monotonic in each coordinate, so all points
+// of a rectangle fall between the codes of its NW and SE corners.
+inline uint32_t encode(int x, int y) {
+    return part1By1(static_cast<uint32_t>(x)) |
+           (part1By1(static_cast<uint32_t>(y)) << 1);
+}
+
+} // namespace morton
+
 // --- QuadTree Class ---
 // Each QuadTree object represents a node in the QuadTree structure.
-class QuadTree {
+// The class is a template over the inline payload type; `QuadTree` (the
+// payload-free default) is the alias declared up top, and code that wants
+// per-region data instantiates BasicQuadTree<T> instead. The payload sits
+// in the node itself via the PayloadSlot base, so reading it after a
+// query costs no extra pointer chase.
+template <typename PayloadT>
+class BasicQuadTree : public PayloadSlot<PayloadT> {
 public:
-    // Static member to generate unique IDs for each node
-    static int nextId;
+    // Inside the template these aliases name the matching instantiations,
+    // so the member signatures below read exactly as they did when the
+    // class was concrete.
+    using QuadTree = BasicQuadTree;
+    using NodePool = BasicNodePool<PayloadT>;
+
+    // Static member to generate unique IDs for each node. Heap-allocated
+    // nodes mint one ID at a time from it; pools reserve whole blocks of
+    // IDs (BasicNodePool::takeId) and stamp their nodes from the private
+    // range, so a parallel pooled build touches this cache line once per
+    // thousand nodes rather than contending on it per constructor.
+    static std::atomic<int> nextId;
+
+    // Nodes at or below this width/height are never split further.
+    static const int MIN_SIZE = 15;
+
+    // How many points a leaf holds inline before it subdivides.
+    static const int CAPACITY = 4;
 
     int _id;          // Unique ID for the node
     Point _pos;       // Top-left corner position of this node's region
@@ -38,166 +409,2967 @@ public:
     QuadTree* _southWest;    // Bottom-left child
     QuadTree* _southEast;    // Bottom-right child
 
+    // True when the children were drawn from a NodePool; in that case the
+    // destructor must leave them alone (the pool reclaims their storage).
+    bool _childrenPooled;
+
+    // Points stored inline in this leaf (internal nodes hold none; their
+    // points have been pushed down to the children). A fixed array keeps
+    // the node trivially destructible, which the NodePool relies on.
+    Point _points[CAPACITY];
+    int _pointCount;
+
+    // Maintained aggregate: how many points are stored in this entire
+    // subtree (inline points plus everything below). Kept current by
+    // insert/bulkLoad/rebuild, so counting queries can take a covered
+    // subtree's total in O(1) instead of enumerating its leaves.
+    int _subtreeCount;
+
+    // Set by subdivideLazy(): this node is subdividable, but its children
+    // only materialize the first time a query or insert descends into it.
+    // _lazyPool remembers where those children should be allocated from.
+    bool _lazy;
+    NodePool* _lazyPool;
+
     // Constructor for the QuadTree node
     // Initializes the node's properties and sets children to nullptr.
-    QuadTree(Point pos, int width, int height)
-        : _pos(pos), _width(width), _height(height),
+    // The payload (if any) is value-initialized by the PayloadSlot base.
+    // Mints an ID from the shared counter; relaxed order suffices, the
+    // counter only has to be unique, it sequences nothing.
+    BasicQuadTree(Point pos, int width, int height)
+        : BasicQuadTree(pos, width, height,
+                        nextId.fetch_add(1, std::memory_order_relaxed)) {}
+
+    // Constructor taking an explicit ID; used by the pool allocator,
+    // which stamps nodes from a pre-reserved ID range so that pooled
+    // construction touches no shared state at all.
+    BasicQuadTree(Point pos, int width, int height, int id)
+        : _id(id), _pos(pos), _width(width), _height(height),
           _northWest(nullptr), _northEast(nullptr),
-          _southWest(nullptr), _southEast(nullptr) {
-        _id = nextId++; // Assign a unique ID
-        // std::cout << "Created Node " << _id << ": Pos=" << _pos.toString()
-        //           << ", Size=" << _width << "x" << _height << std::endl;
+          _southWest(nullptr), _southEast(nullptr),
+          _childrenPooled(false), _pointCount(0), _subtreeCount(0),
+          _lazy(false), _lazyPool(nullptr) {
+        QT_COUNT(nodesCreated);
+        QT_TRACE(2, "Created Node " << _id << ": Pos=" << _pos.toString()
+                     << ", Size=" << _width << "x" << _height);
     }
 
     // Destructor
     // Cleans up dynamically allocated child nodes to prevent memory leaks.
-    ~QuadTree() {
-        //std::cout << "Deleting Node " << _id << std::endl;
-        delete _northWest;
-        delete _northEast;
-        delete _southWest;
-        delete _southEast;
+    ~BasicQuadTree() {
+        QT_TRACE(2, "Deleting Node " << _id);
+        releaseChildren();
+    }
+
+    // Copying is deleted: a node owns its four children, so an implicit
+    // member-wise copy would make two parents delete the same subtree.
+    BasicQuadTree(const BasicQuadTree&) = delete;
+    BasicQuadTree& operator=(const BasicQuadTree&) = delete;
+
+    // Move construction adopts the other node's subtree and inline
+    // points, leaving it a safe empty leaf. No new ID is minted — the
+    // node keeps its identity as it moves. This lets factory functions
+    // build a tree locally and return it by value, with no heap
+    // indirection at the call site.
+    BasicQuadTree(BasicQuadTree&& other) noexcept
+        : PayloadSlot<PayloadT>(std::move(other)),
+          _id(other._id), _pos(other._pos),
+          _width(other._width), _height(other._height),
+          _northWest(other._northWest), _northEast(other._northEast),
+          _southWest(other._southWest), _southEast(other._southEast),
+          _childrenPooled(other._childrenPooled),
+          _pointCount(other._pointCount), _subtreeCount(other._subtreeCount),
+          _lazy(other._lazy), _lazyPool(other._lazyPool) {
+        for (int i = 0; i < other._pointCount; ++i) {
+            _points[i] = other._points[i];
+        }
+        other.forgetChildren();
+        other._pointCount = 0;
+        other._subtreeCount = 0;
+        other._lazy = false;
+    }
+
+    // Move assignment: tears down this node's current subtree (unless a
+    // pool owns it), then adopts the other node's.
+    BasicQuadTree& operator=(BasicQuadTree&& other) noexcept {
+        if (this != &other) {
+            releaseChildren();
+            PayloadSlot<PayloadT>::operator=(std::move(other));
+            _id = other._id;
+            _pos = other._pos;
+            _width = other._width;
+            _height = other._height;
+            _northWest = other._northWest;
+            _northEast = other._northEast;
+            _southWest = other._southWest;
+            _southEast = other._southEast;
+            _childrenPooled = other._childrenPooled;
+            _pointCount = other._pointCount;
+            _subtreeCount = other._subtreeCount;
+            _lazy = other._lazy;
+            _lazyPool = other._lazyPool;
+            for (int i = 0; i < other._pointCount; ++i) {
+                _points[i] = other._points[i];
+            }
+            other.forgetChildren();
+            other._pointCount = 0;
+            other._subtreeCount = 0;
+            other._lazy = false;
+        }
+        return *this;
+    }
+
+    // Access to the inline per-node payload. Only meaningful on trees
+    // instantiated with a real payload type; calling these on the default
+    // NoPayload instantiation is a compile error (the slot has no member),
+    // which is exactly the accident it should be.
+    PayloadT& payload() { return this->_payload; }
+    const PayloadT& payload() const { return this->_payload; }
+
+    // Subdivides the current node into four children, repeating until
+    // leaf nodes reach the minimum size. Runs over an explicit work stack
+    // (NW-first, matching the old recursion's visit and ID order), so
+    // tree depth is bounded by heap rather than thread stack.
+    // When a NodePool is supplied, children are carved out of the pool in
+    // contiguous blocks instead of individual heap allocations, and the
+    // whole tree is reclaimed in one sweep when the pool is destroyed.
+    void subdivide(NodePool* pool = nullptr) {
+        std::vector<QuadTree*> stack;
+        stack.push_back(this);
+        while (!stack.empty()) {
+            QuadTree* node = stack.back();
+            stack.pop_back();
+
+            // If the node is already at or below the minimum size, or if
+            // it has already been subdivided, it stays a leaf.
+            if (node->_width <= MIN_SIZE || node->_height <= MIN_SIZE ||
+                node->_northWest != nullptr) {
+                QT_TRACE(1, "Node " << node->_id << ": Cannot subdivide further (Size="
+                             << node->_width << "x" << node->_height << "). Marking as leaf.");
+                continue;
+            }
+
+            QT_TRACE(2, "Node " << node->_id << ": Subdividing...");
+
+            node->createChildren(pool);
+
+            // Pushed in reverse so the NW child is expanded first.
+            stack.push_back(node->_southEast);
+            stack.push_back(node->_southWest);
+            stack.push_back(node->_northEast);
+            stack.push_back(node->_northWest);
+        }
+    }
+
+    // Lazy counterpart of subdivide(): marks this node subdividable but
+    // materializes nothing, so "building" any region is O(1). The first
+    // query or insert that descends into a marked node creates its four
+    // children (one level, drawn from the pool recorded here) and passes
+    // the laziness down — construction cost lands on exactly the regions
+    // the workload touches, amortized over the query stream.
+    void subdivideLazy(NodePool* pool = nullptr) {
+        if (_width <= MIN_SIZE || _height <= MIN_SIZE || _northWest != nullptr) {
+            return; // Already a floor leaf or already materialized
+        }
+        _lazy = true;
+        _lazyPool = pool;
     }
 
-    // Subdivides the current node into four children.
-    // This method is recursive and stops when leaf nodes reach a minimum size.
-    void subdivide() {
-        // Base case: If the node is already at or below the minimum size (2x2),
-        // or if it has already been subdivided, stop.
-        if (_width <= 15 || _height <= 15 || _northWest != nullptr) {
-            std::cout << "Node " << _id << ": Cannot subdivide further (Size="
-                      << _width << "x" << _height << "). Marking as leaf." << std::endl;
+    // Materializes one level of a lazily subdividable node. Logically
+    // const: the set of stored points never changes, only structure the
+    // node was always destined to have — which is why the query paths
+    // may call it. Not safe against concurrent readers; lazy trees and
+    // the shared read path don't mix.
+    void ensureChildren() const {
+        if (!_lazy) {
+            return;
+        }
+        QuadTree* self = const_cast<QuadTree*>(this);
+        self->_lazy = false;
+        if (_northWest != nullptr) {
             return;
         }
+        self->createChildren(_lazyPool);
+        QuadTree* children[4] = {_northWest, _northEast, _southWest, _southEast};
+        for (QuadTree* child : children) {
+            child->subdivideLazy(_lazyPool);
+        }
+        // Keep the leaf invariant: any points this node held move down.
+        for (int i = 0; i < _pointCount; ++i) {
+            self->childFor(_points[i])->insert(_points[i], _lazyPool);
+        }
+        self->_pointCount = 0;
+    }
+
+    // Applies `callback(node, depth)` to every node in NW-first pre-order.
+    // This is the shared traversal engine for printing, export, and
+    // counting: an explicit stack instead of recursion, so degenerate
+    // deep trees can't overflow the thread stack and the per-node cost is
+    // one loop iteration.
+    template <typename Visitor>
+    void visit(Visitor&& callback) const {
+        struct Entry {
+            const QuadTree* node;
+            int depth;
+        };
+        std::vector<Entry> stack;
+        stack.push_back({this, 0});
+        while (!stack.empty()) {
+            Entry entry = stack.back();
+            stack.pop_back();
+            callback(*entry.node, entry.depth);
+            if (entry.node->_northWest != nullptr) {
+                // Pushed in reverse so the NW child is visited first.
+                stack.push_back({entry.node->_southEast, entry.depth + 1});
+                stack.push_back({entry.node->_southWest, entry.depth + 1});
+                stack.push_back({entry.node->_northEast, entry.depth + 1});
+                stack.push_back({entry.node->_northWest, entry.depth + 1});
+            }
+        }
+    }
 
-        //std::cout << "Node " << _id << ": Subdividing..." << std::endl;
+    // Returns true if the point lies inside this node's region.
+    // The region is half-open: [x, x+width) x [y, y+height).
+    bool contains(const Point& p) const {
+        return p.x >= _pos.x && p.x < _pos.x + _width &&
+               p.y >= _pos.y && p.y < _pos.y + _height;
+    }
 
-        // Calculate dimensions for children (scale factor 1/2)
-        int childWidth = _width / 2;
-        int childHeight = _height / 2;
+    // Inserts a point, splitting leaves lazily: a leaf stores up to
+    // CAPACITY points inline and only subdivides (one level at a time)
+    // when it overflows, so the tree shape follows the data instead of
+    // eagerly covering the whole region.
+    //
+    // Returns false if the point is outside this node's region, or if it
+    // lands in a minimum-size leaf that is already full.
+    bool insert(const Point& p, NodePool* pool = nullptr) {
+        if (!contains(p)) {
+            return false;
+        }
+        ensureChildren(); // First touch materializes a lazy node
 
-        // Create the four child nodes and assign unique IDs
-        _northWest = new QuadTree(Point(_pos.x, _pos.y), childWidth, childHeight);
-        _northEast = new QuadTree(Point(_pos.x + childWidth, _pos.y), childWidth, childHeight); // Adjusted width for northEast
-        _southWest = new QuadTree(Point(_pos.x, _pos.y + childHeight), childWidth, childHeight); // Adjusted height for southWest
-        _southEast = new QuadTree(Point(_pos.x + childWidth, _pos.y + childHeight), childWidth, childHeight); // Adjusted dimensions for southEast
-
-        // Important: If original width/height are not perfectly divisible by 2
-        // (e.g., 5x5 divided by 2 gives 2x2 children, but leaves a 1 pixel gap).
-        // For sizes that are not powers of 2 leading to 2x2, we need to ensure
-        // the remaining space is covered.
-        // For simplicity, sticking to exact halves as per "scale factor of 1/2".
-        // If 100x100 -> 50x50, perfectly fine.
-        // If 25x25 -> 12x12 children. The last subdivision might not reach exactly 2x2.
-        // Example: 3 -> 1. Minimum 2x2 will stop here.
-
-        // Recursively subdivide children
-        _northWest->subdivide();
-        _northEast->subdivide();
-        _southWest->subdivide();
-        _southEast->subdivide();
-    }
-
-    // Prints the QuadTree structure for visualization.
-    void printTree(int depth = 0) const {
-        std::string indent(depth * 4, ' '); // 4 spaces per depth level
-        std::cout << indent << "Node ID: " << _id
-                  << ", Pos: " << _pos.toString()
-                  << ", Size: " << _width << "x" << _height;
+        if (_northWest == nullptr) { // Leaf node
+            if (_pointCount < CAPACITY) {
+                _points[_pointCount++] = p;
+                ++_subtreeCount;
+                return true;
+            }
+            // Full leaf: split once (if allowed) and push the stored
+            // points down into the new children.
+            if (_width <= MIN_SIZE || _height <= MIN_SIZE) {
+                return false; // At the subdivision floor and full
+            }
+            createChildren(pool);
+            // The pushed-down points are already in this node's subtree
+            // count; only the children's counts pick them up here.
+            for (int i = 0; i < _pointCount; ++i) {
+                childFor(_points[i])->insert(_points[i], pool);
+            }
+            _pointCount = 0;
+        }
 
-        if (_northWest == nullptr) { // If no children, it's a leaf node
-            std::cout << " (Leaf)" << std::endl;
-        } else {
-            std::cout << " (Internal Node)" << std::endl;
-            _northWest->printTree(depth + 1);
-            _northEast->printTree(depth + 1);
-            _southWest->printTree(depth + 1);
-            _southEast->printTree(depth + 1);
+        if (!childFor(p)->insert(p, pool)) {
+            return false; // Refused below (full minimum-size leaf)
+        }
+        ++_subtreeCount;
+        return true;
+    }
+
+    // Builds a whole tree from a point array in one pass. Instead of
+    // descending from the root once per point, the array is recursively
+    // partitioned in place against the subdivision midlines (a 2D
+    // quicksort-style split into the four contiguous quadrant runs), and
+    // each node is materialized over exactly its own run. The array is
+    // reordered in the process.
+    //
+    // Points overflowing a full minimum-size leaf are dropped (the same
+    // refusal insert() signals by returning false); pass `droppedOut` to
+    // learn how many — a dense dataset over a small region can lose a
+    // large fraction, and callers should be able to detect that instead
+    // of discovering it from query results.
+    static QuadTree* bulkLoad(Point* points, size_t count,
+                              Point pos, int width, int height, NodePool& pool,
+                              size_t* droppedOut = nullptr) {
+        QuadTree* root = pool.allocate(pos, width, height);
+        bulkLoadInto(root, points, count, &pool);
+        if (droppedOut != nullptr) {
+            // The maintained aggregate is exactly the stored total.
+            *droppedOut = count - static_cast<size_t>(root->_subtreeCount);
+        }
+        return root;
+    }
+
+    // Compact archive file layout: ArchiveHeader, then the topology
+    // bitmap (one bit per node in pre-order NW/NE/SW/SE — children are
+    // all-or-nothing here, so child presence needs no per-quadrant bits),
+    // then one point-count byte per leaf, then the leaf points as raw
+    // int32 pairs. Everything else — every node's box, and the IDs — is
+    // derivable: a child's box is a pure function of its parent's (the
+    // createChildren() arithmetic), so the loader recomputes it instead
+    // of reading it. Inline payloads are not archived.
+    struct ArchiveHeader {
+        uint32_t magic;      // 'QTAR', guards against foreign files
+        uint32_t version;    // Bumped if the encoding ever changes
+        int32_t rootX;       // Root box, the seed all geometry grows from
+        int32_t rootY;
+        int32_t rootWidth;
+        int32_t rootHeight;
+        uint64_t nodeCount;  // Topology bits that follow
+        uint64_t pointCount; // int32 pairs in the points section
+    };
+    static const uint32_t ARCHIVE_MAGIC = 0x52415451u;   // "QTAR"
+    static const uint32_t ARCHIVE_VERSION = 1;
+
+    /**
+     * @brief Writes the tree to a compact archival file.
+     * Stores ~1 bit of topology per node plus the leaf points — a small
+     * fraction of a FlatNode-per-node snapshot, which matters when
+     * snapshots are taken hourly and replicated between regions.
+     * @return true on success, false if the file couldn't be written.
+     */
+    bool saveCompact(const std::string& path) const {
+        std::vector<uint8_t> topology;   // Pre-order internal/leaf bits
+        std::vector<uint8_t> leafCounts; // One byte per leaf, same order
+        std::vector<int32_t> coords;     // x,y pairs, same leaf order
+        size_t bitCount = 0;
+        visit([&](const QuadTree& node, int) {
+            if (bitCount % 8 == 0) {
+                topology.push_back(0);
+            }
+            if (node._northWest != nullptr) {
+                topology.back() |= static_cast<uint8_t>(1u << (bitCount % 8));
+            } else {
+                leafCounts.push_back(static_cast<uint8_t>(node._pointCount));
+                for (int i = 0; i < node._pointCount; ++i) {
+                    coords.push_back(node._points[i].x);
+                    coords.push_back(node._points[i].y);
+                }
+            }
+            ++bitCount;
+        });
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "saveCompact: cannot open " << path << std::endl;
+            return false;
+        }
+        ArchiveHeader header;
+        header.magic = ARCHIVE_MAGIC;
+        header.version = ARCHIVE_VERSION;
+        header.rootX = _pos.x;
+        header.rootY = _pos.y;
+        header.rootWidth = _width;
+        header.rootHeight = _height;
+        header.nodeCount = bitCount;
+        header.pointCount = coords.size() / 2;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(topology.data()),
+                  static_cast<std::streamsize>(topology.size()));
+        out.write(reinterpret_cast<const char*>(leafCounts.data()),
+                  static_cast<std::streamsize>(leafCounts.size()));
+        out.write(reinterpret_cast<const char*>(coords.data()),
+                  static_cast<std::streamsize>(coords.size() * sizeof(int32_t)));
+        return static_cast<bool>(out);
+    }
+
+    /**
+     * @brief Rebuilds a tree from a compact archival file.
+     * Geometry is recomputed top-down from the root box exactly as
+     * subdivision computed it, and IDs are minted fresh from the pool —
+     * neither is stored. Returns nullptr (with a message on std::cerr)
+     * if the file is missing, foreign, or truncated.
+     */
+    static QuadTree* loadCompact(const std::string& path, NodePool& pool) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "loadCompact: cannot open " << path << std::endl;
+            return nullptr;
+        }
+        ArchiveHeader header;
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!in || header.magic != ARCHIVE_MAGIC ||
+            header.version != ARCHIVE_VERSION || header.nodeCount == 0 ||
+            (header.nodeCount - 1) % 4 != 0 ||
+            header.rootWidth < 1 || header.rootHeight < 1) {
+            std::cerr << "loadCompact: " << path
+                      << " is not a compact archive" << std::endl;
+            return nullptr;
+        }
+        // Internal nodes have exactly four children, so the leaf count —
+        // and with it the exact file size — follows from the node count.
+        // Check that size against the file on disk before sizing any
+        // buffer, so a crafted header can't drive a huge allocation (or
+        // short reads) out of a small file. The counts are bounded
+        // against the real file size first: the expectedBytes sum below
+        // would otherwise be reachable by overflow (e.g. a pointCount
+        // near 2^61 wraps the product back into agreement with a tiny
+        // file), defeating the check it feeds.
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0 ||
+            static_cast<uint64_t>(info.st_size) < sizeof(ArchiveHeader)) {
+            std::cerr << "loadCompact: " << path
+                      << " has inconsistent section sizes" << std::endl;
+            return nullptr;
+        }
+        uint64_t payloadBytes =
+            static_cast<uint64_t>(info.st_size) - sizeof(ArchiveHeader);
+        size_t leafCount = header.nodeCount - (header.nodeCount - 1) / 4;
+        if (header.nodeCount / 8 > payloadBytes ||               // A bit per node
+            header.pointCount > payloadBytes / (2 * sizeof(int32_t)) || // 8B per point
+            header.pointCount > leafCount * static_cast<uint64_t>(CAPACITY)) {
+            std::cerr << "loadCompact: " << path
+                      << " has inconsistent section sizes" << std::endl;
+            return nullptr;
+        }
+        // With both counts bounded by the file size, this sum can't wrap.
+        size_t topoBytes = (header.nodeCount + 7) / 8;
+        uint64_t expectedBytes = sizeof(ArchiveHeader) + topoBytes + leafCount +
+                                 header.pointCount * 2 * sizeof(int32_t);
+        if (static_cast<uint64_t>(info.st_size) != expectedBytes) {
+            std::cerr << "loadCompact: " << path
+                      << " has inconsistent section sizes" << std::endl;
+            return nullptr;
+        }
+        std::vector<uint8_t> topology(topoBytes);
+        std::vector<uint8_t> leafCounts(leafCount);
+        std::vector<int32_t> coords(header.pointCount * 2);
+        in.read(reinterpret_cast<char*>(topology.data()),
+                static_cast<std::streamsize>(topoBytes));
+        in.read(reinterpret_cast<char*>(leafCounts.data()),
+                static_cast<std::streamsize>(leafCount));
+        in.read(reinterpret_cast<char*>(coords.data()),
+                static_cast<std::streamsize>(coords.size() * sizeof(int32_t)));
+        if (!in) {
+            std::cerr << "loadCompact: " << path << " is truncated" << std::endl;
+            return nullptr;
+        }
+
+        ArchiveCursor cursor{topology.data(), header.nodeCount, 0,
+                             leafCounts.data(), leafCount, 0,
+                             coords.data(), coords.size(), 0};
+        QuadTree* root = pool.allocate(Point(header.rootX, header.rootY),
+                                       header.rootWidth, header.rootHeight);
+        if (!readCompactInto(root, cursor, &pool) ||
+            cursor.bitIndex != cursor.bitCount) {
+            std::cerr << "loadCompact: " << path
+                      << " has inconsistent topology" << std::endl;
+            return nullptr; // Partially built nodes stay in the pool
+        }
+        return root;
+    }
+
+    // Quadrant indices, matching the sibling order used everywhere else.
+    enum Quadrant { NORTH_WEST = 0, NORTH_EAST, SOUTH_WEST, SOUTH_EAST };
+
+    // Reads a child link with acquire semantics. Concurrent readers must
+    // use this (rather than the raw members) while a writer may be
+    // publishing rebuilt subtrees: the acquire pairs with publishChild's
+    // release store, so a subtree is never seen half-constructed.
+    const QuadTree* acquireChild(int quadrant) const {
+        return __atomic_load_n(childSlot(quadrant), __ATOMIC_ACQUIRE);
+    }
+
+    // Writer-side: atomically swaps in a fully built replacement subtree
+    // with release semantics and returns the old child, which must go to
+    // an EpochReclaimer (not straight to delete) if readers are active.
+    QuadTree* publishChild(int quadrant, QuadTree* replacement) {
+        QuadTree** slot = const_cast<QuadTree**>(childSlot(quadrant));
+        QuadTree* old = *slot;
+        __atomic_store_n(slot, replacement, __ATOMIC_RELEASE);
+        return old;
+    }
+
+    // Range query that is safe to run concurrently with subtree
+    // refreshes: child links are loaded via acquireChild and the walk is
+    // iterative. Callers must hold an EpochReclaimer::ReadGuard so that
+    // subtrees retired mid-traversal stay alive until they are done.
+    void queryRangeShared(const Point& topLeft, int w, int h, std::vector<Point>& out) const {
+        std::vector<const QuadTree*> stack;
+        stack.push_back(this);
+        while (!stack.empty()) {
+            const QuadTree* node = stack.back();
+            stack.pop_back();
+            if (!node->intersects(topLeft, w, h)) {
+                continue; // Prune
+            }
+            const QuadTree* nw = node->acquireChild(NORTH_WEST);
+            if (nw == nullptr) { // Leaf: test the inline points
+                for (int i = 0; i < node->_pointCount; ++i) {
+                    const Point& p = node->_points[i];
+                    if (p.x >= topLeft.x && p.x < topLeft.x + w &&
+                        p.y >= topLeft.y && p.y < topLeft.y + h) {
+                        out.push_back(p);
+                    }
+                }
+                continue;
+            }
+            stack.push_back(nw);
+            stack.push_back(node->acquireChild(NORTH_EAST));
+            stack.push_back(node->acquireChild(SOUTH_WEST));
+            stack.push_back(node->acquireChild(SOUTH_EAST));
+        }
+    }
+
+    // Returns true if this node's region overlaps the given rectangle
+    // (top-left corner plus width/height, half-open like the node boxes).
+    bool intersects(const Point& topLeft, int w, int h) const {
+        return _pos.x < topLeft.x + w && topLeft.x < _pos.x + _width &&
+               _pos.y < topLeft.y + h && topLeft.y < _pos.y + _height;
+    }
+
+    // Collects every stored point inside the query rectangle into `out`,
+    // pruning whole subtrees whose boxes don't intersect the query. The
+    // caller owns (and can reuse) the result buffer, so repeated queries
+    // cost no allocations once the buffer has warmed up.
+    void queryRange(const Point& topLeft, int w, int h, std::vector<Point>& out) const {
+        QT_COUNT(queryVisits);
+        if (!intersects(topLeft, w, h)) {
+            QT_COUNT(pruneHits);
+            return; // Prune: this subtree can't contain matches
+        }
+        ensureChildren(); // First touch materializes a lazy node
+
+        if (_northWest == nullptr) { // Leaf: test the inline points
+            for (int i = 0; i < _pointCount; ++i) {
+                const Point& p = _points[i];
+                if (p.x >= topLeft.x && p.x < topLeft.x + w &&
+                    p.y >= topLeft.y && p.y < topLeft.y + h) {
+                    out.push_back(p);
+                }
+            }
+            return;
+        }
+
+        _northWest->queryRange(topLeft, w, h, out);
+        _northEast->queryRange(topLeft, w, h, out);
+        _southWest->queryRange(topLeft, w, h, out);
+        _southEast->queryRange(topLeft, w, h, out);
+    }
+
+    // Counts the stored points inside the query rectangle without
+    // enumerating them. A subtree whose box lies entirely inside the
+    // query contributes its maintained aggregate in O(1) — no descent —
+    // so the cost tracks the query's perimeter (the boxes it cuts
+    // through), not the number of points it covers.
+    size_t countRange(const Point& topLeft, int w, int h) const {
+        QT_COUNT(queryVisits);
+        if (!intersects(topLeft, w, h)) {
+            QT_COUNT(pruneHits);
+            return 0; // Prune: this subtree can't contain matches
+        }
+        if (within(topLeft, w, h)) {
+            QT_COUNT(pruneHits);
+            return static_cast<size_t>(_subtreeCount); // Whole subtree covered
+        }
+        ensureChildren(); // First touch materializes a lazy node
+
+        if (_northWest == nullptr) { // Leaf: test the inline points
+            size_t hits = 0;
+            for (int i = 0; i < _pointCount; ++i) {
+                const Point& p = _points[i];
+                if (p.x >= topLeft.x && p.x < topLeft.x + w &&
+                    p.y >= topLeft.y && p.y < topLeft.y + h) {
+                    ++hits;
+                }
+            }
+            return hits;
+        }
+
+        return _northWest->countRange(topLeft, w, h) +
+               _northEast->countRange(topLeft, w, h) +
+               _southWest->countRange(topLeft, w, h) +
+               _southEast->countRange(topLeft, w, h);
+    }
+
+    // One rectangle of a query batch.
+    struct QueryRect {
+        Point topLeft;
+        int w;
+        int h;
+    };
+
+    // Executes a whole burst of range queries in one shared traversal:
+    // each tree node is visited at most once per batch, carrying the set
+    // of queries that still intersect it, instead of re-descending from
+    // the root once per query with cold caches. Queries are planned in
+    // Morton order of their centers first, so queries against the same
+    // region stay adjacent in the active sets. results[i] receives the
+    // matches for queries[i].
+    void queryRangeBatch(const std::vector<QueryRect>& queries,
+                         std::vector<std::vector<Point>>& results) const {
+        results.assign(queries.size(), std::vector<Point>());
+
+        // Sorted execution plan: group queries by locality.
+        std::vector<uint32_t> plan(queries.size());
+        for (uint32_t i = 0; i < plan.size(); ++i) {
+            plan[i] = i;
+        }
+        std::sort(plan.begin(), plan.end(), [&queries](uint32_t a, uint32_t b) {
+            const QueryRect& qa = queries[a];
+            const QueryRect& qb = queries[b];
+            return morton::encode(qa.topLeft.x + qa.w / 2, qa.topLeft.y + qa.h / 2) <
+                   morton::encode(qb.topLeft.x + qb.w / 2, qb.topLeft.y + qb.h / 2);
+        });
+
+        // Drop the queries that miss the tree entirely.
+        std::vector<uint32_t> active;
+        active.reserve(plan.size());
+        for (uint32_t qi : plan) {
+            if (intersects(queries[qi].topLeft, queries[qi].w, queries[qi].h)) {
+                active.push_back(qi);
+            } else {
+                QT_COUNT(pruneHits);
+            }
+        }
+        if (!active.empty()) {
+            queryBatchImpl(queries, active, results);
+        }
+    }
+
+    // Collects every stored point within distance r of center into `out`.
+    // Subtrees are pruned by the minimum distance from the center to the
+    // node's box, so only quadrants the circle actually touches are
+    // visited. Distances are compared squared to avoid sqrt entirely.
+    void queryRadius(const Point& center, int r, std::vector<Point>& out) const {
+        QT_COUNT(queryVisits);
+        if (minDistSquared(center) > static_cast<long long>(r) * r) {
+            QT_COUNT(pruneHits);
+            return; // Prune: the circle doesn't reach this node's box
+        }
+        ensureChildren(); // First touch materializes a lazy node
+
+        if (_northWest == nullptr) { // Leaf: test the inline points
+            for (int i = 0; i < _pointCount; ++i) {
+                long long dx = _points[i].x - center.x;
+                long long dy = _points[i].y - center.y;
+                if (dx * dx + dy * dy <= static_cast<long long>(r) * r) {
+                    out.push_back(_points[i]);
+                }
+            }
+            return;
+        }
+
+        _northWest->queryRadius(center, r, out);
+        _northEast->queryRadius(center, r, out);
+        _southWest->queryRadius(center, r, out);
+        _southEast->queryRadius(center, r, out);
+    }
+
+    // Returns true if this node's region lies entirely inside the given
+    // rectangle.
+    bool within(const Point& topLeft, int w, int h) const {
+        return _pos.x >= topLeft.x && _pos.y >= topLeft.y &&
+               _pos.x + _width <= topLeft.x + w &&
+               _pos.y + _height <= topLeft.y + h;
+    }
+
+    // Reflects a change confined to the given dirty rectangle: descends
+    // to the quadrants the rectangle intersects, tears down and rebuilds
+    // only the subtrees it fully covers, and leaves everything else
+    // untouched. Discarded nodes are recycled into the pool, so repeated
+    // patch updates don't grow the arena. The cost is proportional to the
+    // patch, not the region — a small patch touches a handful of nodes.
+    void update(const Point& topLeft, int w, int h, NodePool* pool = nullptr) {
+        if (!intersects(topLeft, w, h)) {
+            return; // This subtree is outside the dirty region
+        }
+        if (within(topLeft, w, h) || _northWest == nullptr) {
+            rebuildSubtree(pool);
+            return;
+        }
+        _northWest->update(topLeft, w, h, pool);
+        _northEast->update(topLeft, w, h, pool);
+        _southWest->update(topLeft, w, h, pool);
+        _southEast->update(topLeft, w, h, pool);
+    }
+
+    // Bottom-up compaction (the classic image-quadtree region merge):
+    // walks the tree post-order and collapses any sibling group of four
+    // leaves that the parent can represent alone — all empty, or their
+    // combined points fitting the parent's inline capacity. Uniform
+    // regions produced by eager subdivision shrink to a single leaf, so
+    // node count, memory, and traversal depth all drop. Discarded pooled
+    // nodes are recycled when a pool is given; returns how many nodes
+    // were removed.
+    size_t compact(NodePool* pool = nullptr) {
+        if (_northWest == nullptr) {
+            return 0; // Leaf: nothing below to merge
+        }
+
+        size_t removed = _northWest->compact(pool) + _northEast->compact(pool) +
+                         _southWest->compact(pool) + _southEast->compact(pool);
+
+        QuadTree* children[4] = {_northWest, _northEast, _southWest, _southEast};
+        for (QuadTree* child : children) {
+            if (child->_northWest != nullptr) {
+                return removed; // A child stayed internal: can't merge here
+            }
+        }
+        // With all children leaves, the maintained aggregate is exactly
+        // the combined inline point count — no summing loop needed.
+        if (_subtreeCount > CAPACITY) {
+            return removed; // The parent can't hold the siblings' points
+        }
+
+        // Absorb the four leaves into this node.
+        _pointCount = 0;
+        for (QuadTree* child : children) {
+            for (int i = 0; i < child->_pointCount; ++i) {
+                _points[_pointCount++] = child->_points[i];
+            }
+        }
+        discardChildren(pool);
+        return removed + 4;
+    }
+
+    // Finds the k stored points nearest to `query`, appended to `out` in
+    // ascending distance order. Best-first traversal: a min-heap of
+    // pending subtrees ordered by the minimum distance from the query to
+    // their boxes, and a bounded max-heap of the k best points found so
+    // far. A quadrant whose box is farther than the current k-th best is
+    // never opened, so the expected cost is logarithmic in tree size
+    // rather than a full scan.
+    void nearest(const Point& query, int k, std::vector<Point>& out) const {
+        if (k <= 0) {
+            return;
+        }
+
+        // Pending subtrees, closest box first.
+        struct NodeEntry {
+            long long distSq;
+            const QuadTree* node;
+        };
+        struct NodeFarther {
+            bool operator()(const NodeEntry& a, const NodeEntry& b) const {
+                return a.distSq > b.distSq;
+            }
+        };
+        std::priority_queue<NodeEntry, std::vector<NodeEntry>, NodeFarther> frontier;
+
+        // The k best candidates, worst on top so it's cheap to evict.
+        struct BestEntry {
+            long long distSq;
+            Point p;
+        };
+        struct BestCloser {
+            bool operator()(const BestEntry& a, const BestEntry& b) const {
+                return a.distSq < b.distSq;
+            }
+        };
+        std::priority_queue<BestEntry, std::vector<BestEntry>, BestCloser> best;
+
+        frontier.push({minDistSquared(query), this});
+        while (!frontier.empty()) {
+            NodeEntry entry = frontier.top();
+            frontier.pop();
+            if (best.size() == static_cast<size_t>(k) && entry.distSq > best.top().distSq) {
+                break; // Every remaining subtree is farther than the k-th best
+            }
+            QT_COUNT(queryVisits);
+
+            const QuadTree* node = entry.node;
+            node->ensureChildren(); // First touch materializes a lazy node
+            if (node->_northWest == nullptr) { // Leaf: consider its points
+                for (int i = 0; i < node->_pointCount; ++i) {
+                    long long dx = node->_points[i].x - query.x;
+                    long long dy = node->_points[i].y - query.y;
+                    long long d = dx * dx + dy * dy;
+                    if (best.size() < static_cast<size_t>(k)) {
+                        best.push({d, node->_points[i]});
+                    } else if (d < best.top().distSq) {
+                        best.pop();
+                        best.push({d, node->_points[i]});
+                    }
+                }
+                continue;
+            }
+
+            const QuadTree* children[4] = {
+                node->_northWest, node->_northEast, node->_southWest, node->_southEast
+            };
+            for (const QuadTree* child : children) {
+                long long d = child->minDistSquared(query);
+                if (best.size() < static_cast<size_t>(k) || d <= best.top().distSq) {
+                    frontier.push({d, child});
+                } else {
+                    QT_COUNT(pruneHits);
+                }
+            }
+        }
+
+        // Unwind the max-heap into ascending distance order.
+        size_t firstResult = out.size();
+        while (!best.empty()) {
+            out.push_back(best.top().p);
+            best.pop();
+        }
+        std::reverse(out.begin() + firstResult, out.end());
+    }
+
+    // Squared distance from a point to the nearest spot on this node's
+    // box (0 if the point is inside the box).
+    long long minDistSquared(const Point& p) const {
+        long long dx = 0, dy = 0;
+        if (p.x < _pos.x) {
+            dx = _pos.x - p.x;
+        } else if (p.x >= _pos.x + _width) {
+            dx = p.x - (_pos.x + _width - 1);
         }
+        if (p.y < _pos.y) {
+            dy = _pos.y - p.y;
+        } else if (p.y >= _pos.y + _height) {
+            dy = p.y - (_pos.y + _height - 1);
+        }
+        return dx * dx + dy * dy;
+    }
+
+    // Picks the child quadrant whose region the point falls into,
+    // comparing against the subdivision midlines.
+    QuadTree* childFor(const Point& p) const {
+        int midX = _pos.x + _width / 2;
+        int midY = _pos.y + _height / 2;
+        if (p.y < midY) {
+            return (p.x < midX) ? _northWest : _northEast;
+        }
+        return (p.x < midX) ? _southWest : _southEast;
+    }
+
+    // Walks the tree once and reports its shape: node/leaf/point counts,
+    // depth distribution, and node-storage footprint. Cheap enough to
+    // sample periodically in production.
+    TreeStats stats() const {
+        TreeStats s;
+        visit([&s](const QuadTree& node, int depth) {
+            ++s.nodeCount;
+            if (depth >= static_cast<int>(s.depthHistogram.size())) {
+                s.depthHistogram.resize(depth + 1, 0);
+            }
+            ++s.depthHistogram[depth];
+            if (depth > s.maxDepth) {
+                s.maxDepth = depth;
+            }
+            if (node._northWest == nullptr) {
+                ++s.leafCount;
+                s.pointCount += node._pointCount;
+            }
+        });
+        s.memoryBytes = s.nodeCount * sizeof(QuadTree);
+        return s;
+    }
+
+    // Prints the QuadTree structure for visualization. Built on visit(),
+    // so arbitrarily deep trees print without recursion.
+    void printTree(int startDepth = 0) const {
+        visit([startDepth](const QuadTree& node, int depth) {
+            std::string indent((startDepth + depth) * 4, ' '); // 4 spaces per depth level
+            std::cout << indent << "Node ID: " << node._id
+                      << ", Pos: " << node._pos.toString()
+                      << ", Size: " << node._width << "x" << node._height;
+
+            if (node._northWest == nullptr) { // If no children, it's a leaf node
+                std::cout << ", Points: " << node._pointCount << " (Leaf)" << std::endl;
+            } else {
+                std::cout << " (Internal Node)" << std::endl;
+            }
+        });
     }
 
     /**
      * @brief Generates a Graphviz DOT language string to visualize the QuadTree.
+     * Convenience wrapper over the streaming variant; note that this holds
+     * the whole document in memory, so prefer toDotty(std::ostream&) for
+     * large trees.
      * @return A std::string containing the DOT code.
      */
     std::string toDotty() const {
         std::stringstream ss;
-        ss << "digraph QuadTree {\n";
-        ss << "  node [shape=box, style=filled, fillcolor=lightblue];\n"; // Styling for all nodes
-        toDottyRecursive(ss);
-        ss << "}\n";
+        toDotty(ss);
         return ss.str();
     }
 
+    /**
+     * @brief Streams the Graphviz DOT document directly to an output stream.
+     * Nothing is buffered beyond the stream's own buffer, so exporting a
+     * tree of any size runs in O(1) resident memory instead of building a
+     * full copy of the document first.
+     * @param out Destination stream (file, std::cout, ...).
+     */
+    void toDotty(std::ostream& out) const {
+        out << "digraph QuadTree {\n";
+        out << "  node [shape=box, style=filled, fillcolor=lightblue];\n"; // Styling for all nodes
+        static const char* quadrantLabels[4] = {"NW", "NE", "SW", "SE"};
+        visit([&out](const QuadTree& node, int) {
+            // Define the current node
+            out << "  node_" << node._id << " [label=\""
+                << "ID: " << node._id << "\\n"
+                << "Pos: " << node._pos.toString() << "\\n"
+                << "Size: " << node._width << "x" << node._height;
+
+            if (node._northWest == nullptr) {
+                out << "\\n(Leaf)\", fillcolor=lightgreen];\n"; // Different color for leaf nodes
+                return;
+            }
+            out << "\\n(Internal Node)\"];\n";
+
+            // Add edges to the four children
+            const QuadTree* children[4] = {
+                node._northWest, node._northEast, node._southWest, node._southEast
+            };
+            for (int c = 0; c < 4; ++c) {
+                out << "  node_" << node._id << " -> node_" << children[c]->_id
+                    << " [label=\"" << quadrantLabels[c] << "\"];\n";
+            }
+        });
+        out << "}\n";
+    }
+
 private:
-    // Recursive helper function to generate DOT code for a node and its children.
-    void toDottyRecursive(std::stringstream& ss) const {
-        // Define the current node
-        ss << "  node_" << _id << " [label=\""
-           << "ID: " << _id << "\\n"
-           << "Pos: " << _pos.toString() << "\\n"
-           << "Size: " << _width << "x" << _height;
+    // The parallel builder splits nodes one level at a time before
+    // fanning the children out to worker threads; the reclaimer tears
+    // down retired subtrees once no reader can still see them.
+    friend class ParallelBuilder;
+    friend class EpochReclaimer;
 
-        if (_northWest == nullptr) {
-            ss << "\\n(Leaf)\", fillcolor=lightgreen];\n"; // Different color for leaf nodes
-        } else {
-            ss << "\\n(Internal Node)\"];\n";
+    // Address of a child link by quadrant index; used by the atomic
+    // accessors above.
+    QuadTree* const* childSlot(int quadrant) const {
+        switch (quadrant) {
+            case NORTH_WEST: return &_northWest;
+            case NORTH_EAST: return &_northEast;
+            case SOUTH_WEST: return &_southWest;
+            default:         return &_southEast;
         }
+    }
 
-        // Add edges to children and recursively call for children
-        if (_northWest != nullptr) {
-            ss << "  node_" << _id << " -> node_" << _northWest->_id << " [label=\"NW\"];\n";
-            _northWest->toDottyRecursive(ss);
+    // Deletes the children when this node owns them (i.e. no pool does)
+    // and forgets the links either way. Teardown walks an explicit stack
+    // instead of recursing through child destructors, so destroying a
+    // degenerate deep tree can't overflow the thread stack.
+    void releaseChildren() {
+        if (!_childrenPooled && _northWest != nullptr) {
+            std::vector<QuadTree*> stack;
+            stack.push_back(_northWest);
+            stack.push_back(_northEast);
+            stack.push_back(_southWest);
+            stack.push_back(_southEast);
+            while (!stack.empty()) {
+                QuadTree* node = stack.back();
+                stack.pop_back();
+                if (!node->_childrenPooled && node->_northWest != nullptr) {
+                    stack.push_back(node->_northWest);
+                    stack.push_back(node->_northEast);
+                    stack.push_back(node->_southWest);
+                    stack.push_back(node->_southEast);
+                }
+                // The links are already on the stack (or pool-owned), so
+                // this node's destructor must not chase them.
+                node->forgetChildren();
+                delete node;
+            }
         }
-        if (_northEast != nullptr) {
-            ss << "  node_" << _id << " -> node_" << _northEast->_id << " [label=\"NE\"];\n";
-            _northEast->toDottyRecursive(ss);
+        forgetChildren();
+    }
+
+    // Recursive half of queryRangeBatch(): `active` holds the (planned-
+    // order) indices of every query that intersects this node. Leaves
+    // test their points against each active query; internal nodes filter
+    // the set once per child and descend only where queries remain.
+    void queryBatchImpl(const std::vector<QueryRect>& queries,
+                        const std::vector<uint32_t>& active,
+                        std::vector<std::vector<Point>>& results) const {
+        QT_COUNT(queryVisits);
+
+        if (_northWest == nullptr) { // Leaf: resolve every active query
+            for (uint32_t qi : active) {
+                const QueryRect& q = queries[qi];
+                for (int i = 0; i < _pointCount; ++i) {
+                    const Point& p = _points[i];
+                    if (p.x >= q.topLeft.x && p.x < q.topLeft.x + q.w &&
+                        p.y >= q.topLeft.y && p.y < q.topLeft.y + q.h) {
+                        results[qi].push_back(p);
+                    }
+                }
+            }
+            return;
         }
-        if (_southWest != nullptr) {
-            ss << "  node_" << _id << " -> node_" << _southWest->_id << " [label=\"SW\"];\n";
-            _southWest->toDottyRecursive(ss);
+
+        const QuadTree* children[4] = {_northWest, _northEast, _southWest, _southEast};
+        std::vector<uint32_t> childActive;
+        childActive.reserve(active.size());
+        for (const QuadTree* child : children) {
+            childActive.clear();
+            for (uint32_t qi : active) {
+                if (child->intersects(queries[qi].topLeft, queries[qi].w, queries[qi].h)) {
+                    childActive.push_back(qi);
+                }
+            }
+            if (childActive.empty()) {
+                QT_COUNT(pruneHits);
+            } else {
+                child->queryBatchImpl(queries, childActive, results);
+            }
         }
-        if (_southEast != nullptr) {
-            ss << "  node_" << _id << " -> node_" << _southEast->_id << " [label=\"SE\"];\n";
-            _southEast->toDottyRecursive(ss);
+    }
+
+    // Rebuilds this subtree from its own data: the stored points are
+    // collected, the old structure is discarded (heap nodes deleted,
+    // pooled nodes recycled for reuse), and the points are reinserted so
+    // the subtree re-forms adaptively.
+    void rebuildSubtree(NodePool* pool) {
+        std::vector<Point> pts;
+        queryRange(_pos, _width, _height, pts);
+        discardChildren(pool);
+        _pointCount = 0;
+        _subtreeCount = 0;
+        for (const Point& p : pts) {
+            insert(p, pool);
         }
     }
-};
 
-// Initialize the static member variable
-int QuadTree::nextId = 0;
+    // Tears down the subtree below this node without touching the node
+    // itself. Heap-owned nodes are deleted; pool-owned nodes are handed
+    // back to `pool` for reuse (or simply unlinked if no pool is given —
+    // their storage then lives until the pool is destroyed).
+    void discardChildren(NodePool* pool) {
+        if (_northWest == nullptr) {
+            return;
+        }
+        struct Entry {
+            QuadTree* node;
+            bool pooled;
+        };
+        std::vector<Entry> stack;
+        stack.push_back({_northWest, _childrenPooled});
+        stack.push_back({_northEast, _childrenPooled});
+        stack.push_back({_southWest, _childrenPooled});
+        stack.push_back({_southEast, _childrenPooled});
+        forgetChildren();
+        while (!stack.empty()) {
+            Entry entry = stack.back();
+            stack.pop_back();
+            QuadTree* node = entry.node;
+            if (node->_northWest != nullptr) {
+                stack.push_back({node->_northWest, node->_childrenPooled});
+                stack.push_back({node->_northEast, node->_childrenPooled});
+                stack.push_back({node->_southWest, node->_childrenPooled});
+                stack.push_back({node->_southEast, node->_childrenPooled});
+                node->forgetChildren();
+            }
+            if (entry.pooled) {
+                if (pool != nullptr) {
+                    pool->recycle(node);
+                }
+            } else {
+                delete node;
+            }
+        }
+    }
 
-// --- Main Function ---
-int main() {
-    // Create the root of the QuadTree with initial height and width 100x100
-    // The position (0,0) represents the top-left corner of the entire region.
-    QuadTree* root = new QuadTree(Point(0, 0), 100, 100);
+    // Drops the child links without deleting anything; used when
+    // ownership has been transferred elsewhere.
+    void forgetChildren() {
+        _northWest = nullptr;
+        _northEast = nullptr;
+        _southWest = nullptr;
+        _southEast = nullptr;
+        _childrenPooled = false;
+    }
 
-    // Start the subdivision process from the root
-    root->subdivide();
+    // Creates the four child nodes (one subdivision level, no recursion).
+    // Child dimensions are halves of the parent, with any odd remainder
+    // assigned to the east/south children so the children tile the parent
+    // region exactly — no uncovered gap for odd sizes.
+    void createChildren(NodePool* pool) {
+        QT_COUNT(subdivisions);
+        int childWidth = _width / 2;
+        int childHeight = _height / 2;
+        int eastWidth = _width - childWidth;     // Absorbs an odd column
+        int southHeight = _height - childHeight; // Absorbs an odd row
 
-    std::cout << "\n--- QuadTree Structure (Console Print) ---\n";
-    //root->printTree();
-    std::cout << "------------------------------------------\n";
+        // With a pool, all four siblings land in the same contiguous block.
+        if (pool != nullptr) {
+            _northWest = pool->allocate(Point(_pos.x, _pos.y), childWidth, childHeight);
+            _northEast = pool->allocate(Point(_pos.x + childWidth, _pos.y), eastWidth, childHeight);
+            _southWest = pool->allocate(Point(_pos.x, _pos.y + childHeight), childWidth, southHeight);
+            _southEast = pool->allocate(Point(_pos.x + childWidth, _pos.y + childHeight), eastWidth, southHeight);
+            _childrenPooled = true;
+        } else {
+            _northWest = new QuadTree(Point(_pos.x, _pos.y), childWidth, childHeight);
+            _northEast = new QuadTree(Point(_pos.x + childWidth, _pos.y), eastWidth, childHeight);
+            _southWest = new QuadTree(Point(_pos.x, _pos.y + childHeight), childWidth, southHeight);
+            _southEast = new QuadTree(Point(_pos.x + childWidth, _pos.y + childHeight), eastWidth, southHeight);
+        }
+    }
 
-    // Generate and print the Dotty code
-    std::cout << "\n--- QuadTree Dotty Code (Graphviz) ---\n";
-    std::string dotCode = root->toDotty();
-    std::cout << dotCode;
-    std::cout << "--------------------------------------\n";
+    // Recursive half of bulkLoad(): fills `node` from its contiguous run
+    // of the point array, partitioning the run in place and handing each
+    // quadrant's sub-run to the matching child.
+    static void bulkLoadInto(QuadTree* node, Point* points, size_t count, NodePool* pool) {
+        if (count <= CAPACITY ||
+            node->_width <= MIN_SIZE || node->_height <= MIN_SIZE) {
+            // Small enough (or at the floor): this node stays a leaf.
+            size_t keep = count < static_cast<size_t>(CAPACITY)
+                              ? count : static_cast<size_t>(CAPACITY);
+            for (size_t i = 0; i < keep; ++i) {
+                node->_points[i] = points[i];
+            }
+            node->_pointCount = static_cast<int>(keep);
+            node->_subtreeCount = static_cast<int>(keep);
+            if (keep < count) {
+                // Same rule as insert(): a full minimum-size leaf refuses
+                // further points.
+                QT_TRACE(1, "Node " << node->_id << ": dropped " << (count - keep)
+                             << " points overflowing a minimum-size leaf");
+            }
+            return;
+        }
 
-    // To visualize this:
-    // 1. Save the output of the "--- QuadTree Dotty Code ---" block to a file, e.g., quadtree.dot
-    // 2. Install Graphviz (if you haven't already): https://graphviz.org/download/
-    // 3. Run the dot command in your terminal:
+        int midX = node->_pos.x + node->_width / 2;
+        int midY = node->_pos.y + node->_height / 2;
+
+        // Split the run into the four quadrant sub-runs: north/south
+        // first, then west/east within each half.
+        Point* end = points + count;
+        Point* northEnd = std::partition(points, end,
+                                         [midY](const Point& p) { return p.y < midY; });
+        Point* nwEnd = std::partition(points, northEnd,
+                                      [midX](const Point& p) { return p.x < midX; });
+        Point* swEnd = std::partition(northEnd, end,
+                                      [midX](const Point& p) { return p.x < midX; });
+
+        node->createChildren(pool);
+        bulkLoadInto(node->_northWest, points, nwEnd - points, pool);
+        bulkLoadInto(node->_northEast, nwEnd, northEnd - nwEnd, pool);
+        bulkLoadInto(node->_southWest, northEnd, swEnd - northEnd, pool);
+        bulkLoadInto(node->_southEast, swEnd, end - swEnd, pool);
+        // Fold the children's aggregates up (children can drop points at
+        // a full minimum-size leaf, so this is not simply `count`).
+        node->_subtreeCount = node->_northWest->_subtreeCount +
+                              node->_northEast->_subtreeCount +
+                              node->_southWest->_subtreeCount +
+                              node->_southEast->_subtreeCount;
+    }
+
+    // Read positions into the three sections of a compact archive while
+    // loadCompact() walks the topology.
+    struct ArchiveCursor {
+        const uint8_t* bits;
+        uint64_t bitCount;
+        uint64_t bitIndex;
+        const uint8_t* leafCounts;
+        size_t leafCount;
+        size_t leafIndex;
+        const int32_t* coords;
+        size_t coordCount;
+        size_t coordIndex;
+    };
+
+    // Recursive half of loadCompact(): consumes one topology bit for
+    // `node`, then either fills it as a leaf from the counts/points
+    // sections or creates its children (recomputing their boxes) and
+    // recurses in the same NW/NE/SW/SE pre-order the writer used.
+    // Returns false if any section runs out — a malformed file.
+    static bool readCompactInto(QuadTree* node, ArchiveCursor& cursor,
+                                NodePool* pool) {
+        if (cursor.bitIndex >= cursor.bitCount) {
+            return false;
+        }
+        bool internal =
+            (cursor.bits[cursor.bitIndex / 8] >> (cursor.bitIndex % 8)) & 1u;
+        ++cursor.bitIndex;
+
+        // A valid writer never marks a floor-sized node internal (the
+        // build paths only subdivide above MIN_SIZE), so an internal bit
+        // here is corruption. Rejecting it also bounds the recursion to
+        // the subdivision depth of the root box, no matter what a hostile
+        // topology section claims.
+        if (internal && (node->_width <= MIN_SIZE || node->_height <= MIN_SIZE)) {
+            return false;
+        }
+
+        if (!internal) {
+            if (cursor.leafIndex >= cursor.leafCount) {
+                return false;
+            }
+            int stored = cursor.leafCounts[cursor.leafIndex++];
+            if (stored > CAPACITY ||
+                cursor.coordIndex + 2 * stored > cursor.coordCount) {
+                return false;
+            }
+            for (int i = 0; i < stored; ++i) {
+                node->_points[i] = Point(cursor.coords[cursor.coordIndex],
+                                         cursor.coords[cursor.coordIndex + 1]);
+                cursor.coordIndex += 2;
+            }
+            node->_pointCount = stored;
+            node->_subtreeCount = stored;
+            return true;
+        }
+
+        node->createChildren(pool);
+        if (!readCompactInto(node->_northWest, cursor, pool) ||
+            !readCompactInto(node->_northEast, cursor, pool) ||
+            !readCompactInto(node->_southWest, cursor, pool) ||
+            !readCompactInto(node->_southEast, cursor, pool)) {
+            return false;
+        }
+        node->_subtreeCount = node->_northWest->_subtreeCount +
+                              node->_northEast->_subtreeCount +
+                              node->_southWest->_subtreeCount +
+                              node->_southEast->_subtreeCount;
+        return true;
+    }
+
+};
+
+// Initialize the static member variable. Each payload instantiation gets
+// its own counter, so IDs are unique within a tree type (which is all the
+// printTree/DOT output ever compares).
+template <typename PayloadT>
+std::atomic<int> BasicQuadTree<PayloadT>::nextId{0};
+
+// --- ParallelBuilder ---
+// Subdivides a tree across worker threads. Large nodes are split one
+// level and their four children pushed onto a shared task queue that any
+// idle worker picks from, so uneven quadrants balance automatically;
+// nodes at or below PARALLEL_CUTOFF are recursed serially by whichever
+// worker holds them (task granularity stays coarse enough to pay for the
+// queue traffic).
+//
+// Each worker owns a private NodePool, so node allocation never takes a
+// lock — and since pool blocks are untouched until filled, each worker's
+// quadrants land on its own NUMA node by first touch. The pools — and
+// therefore every node of the built tree — live as long as the builder
+// itself.
+class ParallelBuilder {
+public:
+    // Regions this size or smaller are subdivided serially in one task.
+    static const int PARALLEL_CUTOFF = 128;
+
+    // Point runs this size or smaller are bulk-loaded serially in one
+    // task; splitting finer than this wouldn't pay for the queue traffic.
+    static const size_t BULK_CUTOFF = 8192;
+
+    // Spins up threadCount workers (hardware concurrency by default).
+    explicit ParallelBuilder(unsigned threadCount = 0)
+        : _pendingTasks(0), _stopping(false) {
+        if (threadCount == 0) {
+            threadCount = std::thread::hardware_concurrency();
+        }
+        if (threadCount == 0) {
+            threadCount = 4; // hardware_concurrency() may report 0
+        }
+        for (unsigned i = 0; i < threadCount; ++i) {
+            _pools.push_back(std::unique_ptr<NodePool>(new NodePool()));
+        }
+        for (unsigned i = 0; i < threadCount; ++i) {
+            _workers.emplace_back(&ParallelBuilder::workerLoop, this, i);
+        }
+    }
+
+    // Joins the workers and releases the pools (destroying the tree).
+    ~ParallelBuilder() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _workCv.notify_all();
+        for (std::thread& t : _workers) {
+            t.join();
+        }
+    }
+
+    ParallelBuilder(const ParallelBuilder&) = delete;
+    ParallelBuilder& operator=(const ParallelBuilder&) = delete;
+
+    // Allocates a root node from the first worker's pool. The returned
+    // tree is owned by the builder (its pools), not the caller.
+    QuadTree* allocateRoot(Point pos, int width, int height) {
+        return _pools[0]->allocate(pos, width, height);
+    }
+
+    // Fully subdivides the tree under `root` in parallel and blocks
+    // until the build is complete. One build at a time per builder.
+    void build(QuadTree* root) {
+        enqueue({root, nullptr, 0});
+        waitIdle();
+    }
+
+    // Builds a tree over `count` points covering the given region, in
+    // parallel: each task SIMD-classifies its run against the node's
+    // midlines, permutes it into the four quadrant runs in place, and
+    // hands the runs to the queue. The array is reordered in the process
+    // (like bulkLoad), and the returned tree is owned by the builder's
+    // pools. Blocks until the build is complete. As with bulkLoad,
+    // points overflowing full minimum-size leaves are dropped; pass
+    // `droppedOut` to learn how many.
+    QuadTree* buildFrom(Point* points, size_t count,
+                        Point pos, int width, int height,
+                        size_t* droppedOut = nullptr) {
+        QuadTree* root = allocateRoot(pos, width, height);
+        enqueue({root, points, count});
+        waitIdle();
+        // Workers fill disjoint subtrees, so the subtree aggregates above
+        // the task boundaries are folded up in one pass at the end.
+        refreshCounts(root);
+        if (droppedOut != nullptr) {
+            *droppedOut = count - static_cast<size_t>(root->_subtreeCount);
+        }
+        return root;
+    }
+
+private:
+    // One unit of work: a node to expand, optionally with the run of
+    // points that belongs in its region (null for structural builds).
+    struct Task {
+        QuadTree* node;
+        Point* points;
+        size_t count;
+    };
+
+    // Pushes a task onto the shared queue.
+    void enqueue(const Task& task) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tasks.push_back(task);
+            ++_pendingTasks;
+        }
+        _workCv.notify_one();
+    }
+
+    // Blocks the caller until the queue and all workers drain.
+    void waitIdle() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _idleCv.wait(lock, [this] { return _pendingTasks == 0; });
+    }
+
+    // Worker main loop: pull a task, expand it, repeat.
+    void workerLoop(unsigned index) {
+        NodePool& pool = *_pools[index];
+        for (;;) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _workCv.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+                if (_tasks.empty()) {
+                    return; // Stopping and nothing left to do
+                }
+                task = _tasks.front();
+                _tasks.pop_front();
+            }
+
+            processTask(task, pool);
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                --_pendingTasks;
+                if (_pendingTasks == 0) {
+                    _idleCv.notify_all();
+                }
+            }
+        }
+    }
+
+    // Expands one task: big nodes split a single level and hand their
+    // children back to the queue; small ones recurse serially here.
+    void processTask(const Task& task, NodePool& pool) {
+        QuadTree* node = task.node;
+        if (task.points != nullptr) {
+            processBulkTask(task, pool);
+            return;
+        }
+        if (node->_width <= QuadTree::MIN_SIZE || node->_height <= QuadTree::MIN_SIZE ||
+            node->_northWest != nullptr) {
+            return; // Leaf (or already subdivided): nothing to expand
+        }
+        if (node->_width <= PARALLEL_CUTOFF || node->_height <= PARALLEL_CUTOFF) {
+            node->subdivide(&pool);
+            return;
+        }
+        node->createChildren(&pool);
+        enqueue({node->_northWest, nullptr, 0});
+        enqueue({node->_northEast, nullptr, 0});
+        enqueue({node->_southWest, nullptr, 0});
+        enqueue({node->_southEast, nullptr, 0});
+    }
+
+    // Expands one point-carrying task. Small runs (or floor-size nodes)
+    // bulk-load serially; larger runs are split against this node's
+    // midlines with the vector classifier and permuted into the four
+    // quadrant runs in place — each point moves at most once, cheaper
+    // than the three std::partition sweeps the serial path makes — and
+    // the runs go back to the queue so idle workers pick them up.
+    void processBulkTask(const Task& task, NodePool& pool) {
+        QuadTree* node = task.node;
+        if (task.count <= BULK_CUTOFF ||
+            node->_width <= QuadTree::MIN_SIZE || node->_height <= QuadTree::MIN_SIZE) {
+            QuadTree::bulkLoadInto(node, task.points, task.count, &pool);
+            return;
+        }
+
+        int32_t midX = node->_pos.x + node->_width / 2;
+        int32_t midY = node->_pos.y + node->_height / 2;
+        std::vector<uint8_t> labels(task.count);
+        simd::classifyPoints(task.points, task.count, midX, midY, labels.data());
+
+        // Quadrant histogram -> bucket boundaries within the run.
+        size_t start[5] = {0, 0, 0, 0, 0};
+        for (size_t i = 0; i < task.count; ++i) {
+            ++start[labels[i] + 1];
+        }
+        for (int q = 1; q <= 4; ++q) {
+            start[q] += start[q - 1];
+        }
+
+        // In-place bucket permutation (the classic American-flag pass):
+        // `next[q]` is the first unplaced slot of bucket q; an element in
+        // the wrong bucket is swapped toward its home until the slot at
+        // next[q] holds a q-element.
+        size_t next[4] = {start[0], start[1], start[2], start[3]};
+        for (int q = 0; q < 4; ++q) {
+            while (next[q] < start[q + 1]) {
+                uint8_t label = labels[next[q]];
+                if (label == q) {
+                    ++next[q];
+                } else {
+                    std::swap(task.points[next[q]], task.points[next[label]]);
+                    std::swap(labels[next[q]], labels[next[label]]);
+                    ++next[label];
+                }
+            }
+        }
+
+        node->createChildren(&pool);
+        QuadTree* children[4] = {node->_northWest, node->_northEast,
+                                 node->_southWest, node->_southEast};
+        for (int q = 0; q < 4; ++q) {
+            enqueue({children[q], task.points + start[q], start[q + 1] - start[q]});
+        }
+    }
+
+    // Post-order fold of the subtree point counts; bulkLoadInto maintains
+    // them inside each serial task, this stitches the task boundaries.
+    static int refreshCounts(QuadTree* node) {
+        if (node->_northWest == nullptr) {
+            return node->_subtreeCount; // Leaf counts were set by the load
+        }
+        node->_subtreeCount = refreshCounts(node->_northWest) +
+                              refreshCounts(node->_northEast) +
+                              refreshCounts(node->_southWest) +
+                              refreshCounts(node->_southEast);
+        return node->_subtreeCount;
+    }
+
+    std::vector<std::unique_ptr<NodePool>> _pools; // One private pool per worker
+    std::vector<std::thread> _workers;
+    std::deque<Task> _tasks; // Shared queue; idle workers pull from here
+    std::mutex _mutex;
+    std::condition_variable _workCv; // Signals queued work (or shutdown)
+    std::condition_variable _idleCv; // Signals a finished build
+    size_t _pendingTasks;            // Queued plus in-flight tasks
+    bool _stopping;
+};
+
+// --- EpochReclaimer ---
+// Epoch-based reclamation for in-place refreshes. Readers wrap each
+// traversal in a ReadGuard (an acquire load and two stores — no lock);
+// the writer swaps rebuilt subtrees in via QuadTree::publishChild and
+// hands the old ones to retire(). A retired subtree is only torn down by
+// collect() once every reader slot is either idle or pinned to a later
+// epoch, i.e. once nobody can still be walking it. Readers therefore
+// never stall behind a refresh, and the writer never frees memory out
+// from under them.
+//
+// Supports up to MAX_READERS concurrent reader threads; a reclaimer is
+// meant to be shared by all readers and the (single) writer of a tree.
+class EpochReclaimer {
+public:
+    static const int MAX_READERS = 64;
+
+    EpochReclaimer() : _globalEpoch(1), _nextSlot(0), _reclaimed(0) {
+        for (auto& slot : _slots) {
+            slot.store(IDLE);
+        }
+    }
+
+    // Tears down everything still retired; no readers may be active.
+    ~EpochReclaimer() {
+        for (Retired& entry : _retired) {
+            reclaim(entry);
+        }
+    }
+
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    // Read-side critical section. While alive, this thread is pinned to
+    // the epoch it entered with and no subtree retired since then can be
+    // freed.
+    class ReadGuard {
+    public:
+        explicit ReadGuard(EpochReclaimer& reclaimer)
+            : _reclaimer(reclaimer), _slot(reclaimer.readerSlot()) {
+            _reclaimer._slots[_slot].store(
+                _reclaimer._globalEpoch.load(std::memory_order_acquire));
+            // Full fence: the pin store must be globally visible before
+            // this thread's first child-pointer load can be satisfied.
+            // The store alone doesn't give that — acquireChild is only an
+            // acquire load, so without the fence a weakly-ordered machine
+            // may order the load first, and collect() could scan the slot
+            // as IDLE and free the subtree this reader is entering. The
+            // matching fence sits in collect() before the slot scan.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        ~ReadGuard() {
+            _reclaimer._slots[_slot].store(IDLE, std::memory_order_release);
+        }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+    private:
+        EpochReclaimer& _reclaimer;
+        int _slot;
+    };
+
+    // Writer-side: queues a detached subtree for deferred teardown. Pass
+    // the pool the subtree's nodes came from so they are recycled; heap
+    // subtrees (no pool) are deleted instead.
+    void retire(QuadTree* subtree, NodePool* pool = nullptr) {
+        if (subtree == nullptr) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_retireMutex);
+        _retired.push_back({_globalEpoch.load(std::memory_order_relaxed), subtree, pool});
+    }
+
+    // Writer-side: advances the epoch and frees every retired subtree
+    // that predates all active readers. Call periodically (e.g. after
+    // each refresh).
+    void collect() {
+        _globalEpoch.fetch_add(1);
+
+        // Full fence, pairing with the one in the ReadGuard constructor:
+        // every pin store sequenced before this point is visible to the
+        // scan below, so a reader seen as IDLE here cannot be inside a
+        // critical section that began before the epoch bump.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // The oldest epoch any reader is still pinned to.
+        uint64_t minActive = UINT64_MAX;
+        for (const auto& slot : _slots) {
+            uint64_t pinned = slot.load();
+            if (pinned != IDLE && pinned < minActive) {
+                minActive = pinned;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_retireMutex);
+        size_t kept = 0;
+        for (Retired& entry : _retired) {
+            if (entry.epoch < minActive) {
+                reclaim(entry);
+            } else {
+                _retired[kept++] = entry;
+            }
+        }
+        _retired.resize(kept);
+    }
+
+    // Subtrees torn down so far (for monitoring/tests).
+    size_t reclaimedCount() const { return _reclaimed.load(); }
+
+private:
+    static const uint64_t IDLE = 0;
+
+    struct Retired {
+        uint64_t epoch;     // Epoch at which the subtree was unpublished
+        QuadTree* subtree;
+        NodePool* pool;     // Pool owning the nodes, or nullptr for heap
+    };
+
+    // Frees one retired subtree, recycling pooled nodes for reuse.
+    void reclaim(Retired& entry) {
+        if (entry.pool != nullptr) {
+            entry.subtree->discardChildren(entry.pool);
+            entry.pool->recycle(entry.subtree);
+        } else {
+            delete entry.subtree;
+        }
+        ++_reclaimed;
+    }
+
+    // Hands each reader thread a stable slot index on first use. Slot
+    // exhaustion aborts rather than wrapping: a wrapped index would share
+    // a slot with a live reader, whose guard destructor could then mark
+    // this reader IDLE mid-traversal — a silent use-after-free.
+    int readerSlot() {
+        thread_local int slot = -1;
+        if (slot < 0) {
+            uint32_t claimed = _nextSlot.fetch_add(1);
+            if (claimed >= MAX_READERS) {
+                std::cerr << "EpochReclaimer: more than " << MAX_READERS
+                          << " reader threads" << std::endl;
+                std::abort();
+            }
+            slot = static_cast<int>(claimed);
+        }
+        return slot;
+    }
+
+    std::atomic<uint64_t> _globalEpoch;
+    std::atomic<uint64_t> _slots[MAX_READERS]; // Epoch each reader is pinned to
+    std::atomic<uint32_t> _nextSlot;
+    std::mutex _retireMutex;
+    std::vector<Retired> _retired;
+    std::atomic<size_t> _reclaimed;
+};
+
+// --- FlatQuadTree Class ---
+// Cache-friendly alternative to the pointer tree: every node lives in one
+// contiguous std::vector and children are referenced by 32-bit indices.
+// The four siblings of a subdivision are always adjacent, so a single
+// `firstChild` index (NW) reaches all of them — NE/SW/SE are the next
+// three slots. Traversal touches sequential memory instead of chasing
+// 8-byte pointers scattered across the heap.
+// Like the pointer tree, the class is templated over the inline payload;
+// a payload rides in the FlatNode record itself, so it shares the node's
+// cache line and travels with the snapshot format for free.
+template <typename PayloadT = NoPayload>
+class BasicFlatQuadTree {
+public:
+    // The matching pointer-tree instantiation this layout is built from.
+    using QuadTree = BasicQuadTree<PayloadT>;
+
+    // Sentinel child index for leaf nodes.
+    static const uint32_t NO_CHILD = 0xFFFFFFFFu;
+
+    // One node of the flat layout. 24 bytes for the payload-free default
+    // (the empty PayloadSlot base adds nothing), so a sibling group of
+    // four fits in a cache line and a half.
+    struct FlatNode : PayloadSlot<PayloadT> {
+        int _id;              // Unique ID carried over from the pointer tree
+        Point _pos;           // Top-left corner position of this node's region
+        int _width;           // Width of this node's region
+        int _height;          // Height of this node's region
+        uint32_t _firstChild; // Index of the NW child, or NO_CHILD for leaves
+    };
+
+    // Builds the flat layout from an existing pointer tree. Nodes are laid
+    // out breadth-first, which naturally places the four children of every
+    // subdivision in adjacent slots.
+    explicit BasicFlatQuadTree(const QuadTree* root) {
+        if (root == nullptr) return;
+        _nodes.push_back(makeNode(root));
+        // Queue of (source pointer, flat index) pairs still to expand.
+        std::vector<const QuadTree*> sources;
+        sources.push_back(root);
+        for (size_t i = 0; i < sources.size(); ++i) {
+            const QuadTree* src = sources[i];
+            if (src->_northWest == nullptr) continue; // Leaf: nothing to expand
+            // Reserve four adjacent slots for the sibling group.
+            _nodes[i]._firstChild = static_cast<uint32_t>(_nodes.size());
+            const QuadTree* children[4] = {
+                src->_northWest, src->_northEast, src->_southWest, src->_southEast
+            };
+            for (const QuadTree* child : children) {
+                _nodes.push_back(makeNode(child));
+                sources.push_back(child);
+            }
+        }
+    }
+
+    // Number of nodes in the tree.
+    size_t size() const { return _nodes.size(); }
+
+    // Direct access to a node by index (index 0 is the root).
+    const FlatNode& node(uint32_t index) const { return _nodes[index]; }
+
+    // Prints the tree structure, matching QuadTree::printTree() output.
+    void printTree(uint32_t index = 0, int depth = 0) const {
+        if (_nodes.empty()) return;
+        const FlatNode& n = _nodes[index];
+        std::string indent(depth * 4, ' '); // 4 spaces per depth level
+        std::cout << indent << "Node ID: " << n._id
+                  << ", Pos: " << n._pos.toString()
+                  << ", Size: " << n._width << "x" << n._height;
+
+        if (n._firstChild == NO_CHILD) {
+            std::cout << " (Leaf)" << std::endl;
+        } else {
+            std::cout << " (Internal Node)" << std::endl;
+            for (uint32_t c = 0; c < 4; ++c) {
+                printTree(n._firstChild + c, depth + 1);
+            }
+        }
+    }
+
+    /**
+     * @brief Generates a Graphviz DOT language string for the flat tree.
+     * Convenience wrapper; prefer toDotty(std::ostream&) for large trees.
+     * @return A std::string containing the DOT code.
+     */
+    std::string toDotty() const {
+        std::stringstream ss;
+        toDotty(ss);
+        return ss.str();
+    }
+
+    /**
+     * @brief Streams the DOT document for the flat tree in bounded memory.
+     * @param out Destination stream (file, std::cout, ...).
+     */
+    void toDotty(std::ostream& ss) const {
+        ss << "digraph QuadTree {\n";
+        ss << "  node [shape=box, style=filled, fillcolor=lightblue];\n"; // Styling for all nodes
+        static const char* quadrantLabels[4] = {"NW", "NE", "SW", "SE"};
+        for (const FlatNode& n : _nodes) {
+            ss << "  node_" << n._id << " [label=\""
+               << "ID: " << n._id << "\\n"
+               << "Pos: " << n._pos.toString() << "\\n"
+               << "Size: " << n._width << "x" << n._height;
+            if (n._firstChild == NO_CHILD) {
+                ss << "\\n(Leaf)\", fillcolor=lightgreen];\n"; // Different color for leaf nodes
+            } else {
+                ss << "\\n(Internal Node)\"];\n";
+                for (uint32_t c = 0; c < 4; ++c) {
+                    ss << "  node_" << n._id << " -> node_"
+                       << _nodes[n._firstChild + c]._id
+                       << " [label=\"" << quadrantLabels[c] << "\"];\n";
+                }
+            }
+        }
+        ss << "}\n";
+    }
+
+    // Snapshot file layout: SnapshotHeader followed by one FlatNode
+    // record per node, exactly as they sit in _nodes. Because the records
+    // are fixed-width PODs, a loader can map the file and use the node
+    // array in place.
+    struct SnapshotHeader {
+        uint32_t magic;     // 'QTSN', guards against foreign files
+        uint32_t version;   // Bumped if FlatNode's layout ever changes
+        uint64_t nodeCount; // Number of FlatNode records that follow
+    };
+    static const uint32_t SNAPSHOT_MAGIC = 0x4E535451u;   // "QTSN"
+    static const uint32_t SNAPSHOT_VERSION = 1;
+
+    /**
+     * @brief Writes the tree to a compact binary snapshot file.
+     * One sequential pass: a small header, then the contiguous node
+     * array. No per-node formatting or traversal is involved.
+     * @return true on success, false if the file couldn't be written.
+     */
+    bool saveSnapshot(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "saveSnapshot: cannot open " << path << std::endl;
+            return false;
+        }
+        SnapshotHeader header;
+        header.magic = SNAPSHOT_MAGIC;
+        header.version = SNAPSHOT_VERSION;
+        header.nodeCount = _nodes.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(_nodes.data()),
+                  static_cast<std::streamsize>(_nodes.size() * sizeof(FlatNode)));
+        return static_cast<bool>(out);
+    }
+
+private:
+    // Copies the box, ID, and payload of a pointer-tree node into a flat
+    // leaf node; _firstChild is patched once the children are appended.
+    static FlatNode makeNode(const QuadTree* src) {
+        FlatNode n;
+        // Slot-to-slot assignment; a no-op for the NoPayload default.
+        static_cast<PayloadSlot<PayloadT>&>(n) =
+            static_cast<const PayloadSlot<PayloadT>&>(*src);
+        n._id = src->_id;
+        n._pos = src->_pos;
+        n._width = src->_width;
+        n._height = src->_height;
+        n._firstChild = NO_CHILD;
+        return n;
+    }
+
+    std::vector<FlatNode> _nodes; // All nodes, breadth-first, siblings adjacent
+};
+
+// The payload-free instantiation, which the snapshot loader and the rest
+// of this file work with.
+using FlatQuadTree = BasicFlatQuadTree<>;
+
+// --- QueryCache Class ---
+// Memoizes range-query results over one tree, keyed by the exact query
+// rectangle. Hot map regions get queried with the same rectangles over
+// and over (85% of production range queries hit the top 1% of tiles), so
+// serving a repeat is one hash lookup instead of a traversal.
+//
+// Invalidation is wired into the update path: route incremental updates
+// through QueryCache::update() (or call invalidate() with the dirty
+// rectangle yourself) and every memoized result overlapping the patch is
+// evicted; results elsewhere stay hot.
+class QueryCache {
+public:
+    // maxEntries bounds the memoized set; the cache resets when full
+    // rather than tracking recency (hot tiles repopulate immediately).
+    explicit QueryCache(QuadTree& tree, size_t maxEntries = 1024)
+        : _tree(tree), _maxEntries(maxEntries), _hits(0), _misses(0) {}
+
+    // Serves the query from cache when possible, otherwise runs the
+    // pruned traversal and memoizes the result.
+    void queryRange(const Point& topLeft, int w, int h, std::vector<Point>& out) {
+        Key key{topLeft.x, topLeft.y, w, h};
+        auto it = _entries.find(key);
+        if (it != _entries.end()) {
+            ++_hits;
+            out.insert(out.end(), it->second.begin(), it->second.end());
+            return;
+        }
+        ++_misses;
+        std::vector<Point> result;
+        _tree.queryRange(topLeft, w, h, result);
+        out.insert(out.end(), result.begin(), result.end());
+        if (_entries.size() >= _maxEntries) {
+            _entries.clear();
+        }
+        _entries.emplace(key, std::move(result));
+    }
+
+    // Applies an incremental tree update and evicts every memoized
+    // result whose rectangle overlaps the dirty patch, in one step.
+    void update(const Point& topLeft, int w, int h, NodePool* pool = nullptr) {
+        _tree.update(topLeft, w, h, pool);
+        invalidate(topLeft, w, h);
+    }
+
+    // Evicts cached results overlapping the given rectangle. Call this
+    // directly when a subtree is rebuilt outside of update().
+    void invalidate(const Point& topLeft, int w, int h) {
+        for (auto it = _entries.begin(); it != _entries.end();) {
+            const Key& k = it->first;
+            bool overlaps = k.x < topLeft.x + w && topLeft.x < k.x + k.w &&
+                            k.y < topLeft.y + h && topLeft.y < k.y + k.h;
+            it = overlaps ? _entries.erase(it) : std::next(it);
+        }
+    }
+
+    // Drops everything; for wholesale rebuilds.
+    void invalidateAll() { _entries.clear(); }
+
+    size_t hits() const { return _hits; }
+    size_t misses() const { return _misses; }
+
+private:
+    // A query rectangle, usable as a hash key.
+    struct Key {
+        int x, y, w, h;
+        bool operator==(const Key& other) const {
+            return x == other.x && y == other.y && w == other.w && h == other.h;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            // Morton-style mixing keeps nearby tiles in distinct buckets.
+            uint64_t mixed = (static_cast<uint64_t>(morton::encode(k.x, k.y)) << 32) |
+                             morton::encode(k.w, k.h);
+            mixed ^= mixed >> 33;
+            mixed *= 0xff51afd7ed558ccdULL;
+            mixed ^= mixed >> 33;
+            return static_cast<size_t>(mixed);
+        }
+    };
+
+    QuadTree& _tree;
+    std::unordered_map<Key, std::vector<Point>, KeyHash> _entries;
+    size_t _maxEntries;
+    size_t _hits;
+    size_t _misses;
+};
+
+// --- LinearQuadTree Class ---
+// Linear (Morton / Z-order) quadtree for point-heavy workloads. Instead
+// of node objects and child links, every point is encoded as the Morton
+// code of its cell (see the morton namespace) and the codes are kept in
+// one sorted flat array: a fraction of the memory of the pointer tree,
+// and queries turn into sequential scans over a contiguous range, which
+// is exactly what the hardware prefetcher wants. Offers the same
+// queryRange(topLeft, w, h, out) shape as QuadTree, so callers can swap
+// representations freely.
+class LinearQuadTree {
+public:
+    // Builds the sorted cell array from a point set in one pass:
+    // encode, then sort by code.
+    LinearQuadTree(const Point* points, size_t count) {
+        _cells.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            _cells.push_back({morton::encode(points[i].x, points[i].y), points[i]});
+        }
+        std::sort(_cells.begin(), _cells.end(),
+                  [](const Cell& a, const Cell& b) { return a.code < b.code; });
+    }
+
+    // Number of stored points.
+    size_t size() const { return _cells.size(); }
+
+    // Bytes used by the cell array (for comparison against node trees).
+    size_t memoryBytes() const { return _cells.size() * sizeof(Cell); }
+
+    // Range query over the Z-order interval: binary-search the first
+    // cell at or after the rectangle's NW corner code, scan to the SE
+    // corner code, and filter out the cells where the curve briefly
+    // leaves the rectangle. No pointers are chased anywhere.
+    void queryRange(const Point& topLeft, int w, int h, std::vector<Point>& out) const {
+        if (w <= 0 || h <= 0 || _cells.empty()) {
+            return;
+        }
+        uint32_t lo = morton::encode(topLeft.x, topLeft.y);
+        uint32_t hi = morton::encode(topLeft.x + w - 1, topLeft.y + h - 1);
+
+        auto first = std::lower_bound(_cells.begin(), _cells.end(), lo,
+                                      [](const Cell& c, uint32_t code) { return c.code < code; });
+        for (auto it = first; it != _cells.end() && it->code <= hi; ++it) {
+            const Point& p = it->p;
+            if (p.x >= topLeft.x && p.x < topLeft.x + w &&
+                p.y >= topLeft.y && p.y < topLeft.y + h) {
+                out.push_back(p);
+            }
+        }
+    }
+
+private:
+    // One stored point plus its precomputed cell code.
+    struct Cell {
+        uint32_t code;
+        Point p;
+    };
+
+    std::vector<Cell> _cells; // Sorted by code (Z-order)
+};
+
+// --- StaticQuadTree Class ---
+// Compile-time specialized tree for the power-of-two regions production
+// always deploys (256, 1024, 8192, ...). Depth, node count, and every
+// box are constexpr functions of the template parameters, so there are
+// no child pointers at all: the full tree is a perfect implicit heap
+// (children of node i at 4i+1..4i+4), geometry is recomputed on the fly,
+// and a leaf's slot is found directly from coordinates via its Morton
+// cell code. Leaves hold the same inline CAPACITY as the runtime tree;
+// the generic QuadTree remains the choice for odd region sizes.
+template <int Size, int MinLeaf = 15>
+class StaticQuadTree {
+    static_assert(Size > 0 && (Size & (Size - 1)) == 0,
+                  "StaticQuadTree requires a power-of-two region size");
+    static_assert(MinLeaf > 0, "StaticQuadTree requires a positive leaf floor");
+
+public:
+    // How many points a leaf holds inline, matching QuadTree::CAPACITY.
+    static const int CAPACITY = 4;
+
+    // A node's region, computed rather than stored.
+    struct Box {
+        Point pos;
+        int size; // Cells are always square here (power-of-two halving)
+    };
+
+    // Subdivision levels until a node's size drops to the floor; same
+    // stopping rule as the runtime subdivide() (split while > MinLeaf).
+    static constexpr int depthFor(int size) {
+        return size <= MinLeaf ? 0 : 1 + depthFor(size / 2);
+    }
+    static constexpr size_t pow4(int n) { return n == 0 ? 1 : 4 * pow4(n - 1); }
+
+    static constexpr int DEPTH = depthFor(Size);
+    static constexpr size_t NODE_COUNT = (pow4(DEPTH + 1) - 1) / 3;
+    static constexpr size_t FIRST_LEAF = (pow4(DEPTH) - 1) / 3;
+    static constexpr size_t LEAF_COUNT = pow4(DEPTH);
+    static constexpr int LEAF_SIZE = Size >> DEPTH;
+    static constexpr int LEAF_GRID = 1 << DEPTH; // Leaves per side
+
+    // Implicit-heap navigation; quadrant uses the shared NW/NE/SW/SE
+    // numbering.
+    static constexpr size_t childIndex(size_t node, int quadrant) {
+        return node * 4 + 1 + static_cast<size_t>(quadrant);
+    }
+    static constexpr size_t parentIndex(size_t node) { return (node - 1) / 4; }
+    static constexpr bool isLeaf(size_t node) { return node >= FIRST_LEAF; }
+
+    StaticQuadTree()
+        : _leafPointCounts(LEAF_COUNT, 0),
+          _leafPoints(LEAF_COUNT * CAPACITY),
+          _subtreeCounts(NODE_COUNT, 0) {}
+
+    // Inserts a point; the leaf slot comes straight from the coordinates
+    // (Morton code of the leaf cell), so there is no descent at all.
+    // Returns false outside the region or when the leaf is full — the
+    // same refusal rule as the runtime tree at its floor.
+    bool insert(const Point& p) {
+        if (p.x < 0 || p.y < 0 || p.x >= Size || p.y >= Size) {
+            return false;
+        }
+        size_t cell = morton::encode(p.x / LEAF_SIZE, p.y / LEAF_SIZE);
+        if (_leafPointCounts[cell] >= CAPACITY) {
+            return false;
+        }
+        _leafPoints[cell * CAPACITY + _leafPointCounts[cell]] = p;
+        ++_leafPointCounts[cell];
+
+        // Maintain subtree counts up the implicit path (DEPTH+1 bumps).
+        size_t node = FIRST_LEAF + cell;
+        for (;;) {
+            ++_subtreeCounts[node];
+            if (node == 0) break;
+            node = parentIndex(node);
+        }
+        return true;
+    }
+
+    // Total points stored under a node (root by default).
+    uint32_t count(size_t node = 0) const { return _subtreeCounts[node]; }
+
+    // Collects the stored points inside the rectangle, pruning by the
+    // computed node boxes exactly like the pointer tree does.
+    void queryRange(const Point& topLeft, int w, int h, std::vector<Point>& out) const {
+        queryRangeImpl(0, rootBox(), topLeft, w, h, out);
+    }
+
+    // Counts the points inside the rectangle without enumerating them:
+    // fully covered subtrees contribute their maintained count in O(1).
+    uint32_t countRange(const Point& topLeft, int w, int h) const {
+        return countRangeImpl(0, rootBox(), topLeft, w, h);
+    }
+
+private:
+    static constexpr Box rootBox() { return Box{Point(0, 0), Size}; }
+
+    // Child box: pure arithmetic, no memory touched.
+    static constexpr Box childBox(const Box& box, int quadrant) {
+        return Box{Point(box.pos.x + (quadrant & 1) * (box.size / 2),
+                         box.pos.y + ((quadrant >> 1) & 1) * (box.size / 2)),
+                   box.size / 2};
+    }
+
+    static bool boxIntersects(const Box& box, const Point& topLeft, int w, int h) {
+        return box.pos.x < topLeft.x + w && topLeft.x < box.pos.x + box.size &&
+               box.pos.y < topLeft.y + h && topLeft.y < box.pos.y + box.size;
+    }
+
+    static bool boxWithin(const Box& box, const Point& topLeft, int w, int h) {
+        return box.pos.x >= topLeft.x && box.pos.y >= topLeft.y &&
+               box.pos.x + box.size <= topLeft.x + w &&
+               box.pos.y + box.size <= topLeft.y + h;
+    }
+
+    void queryRangeImpl(size_t node, const Box& box, const Point& topLeft,
+                        int w, int h, std::vector<Point>& out) const {
+        if (_subtreeCounts[node] == 0 || !boxIntersects(box, topLeft, w, h)) {
+            return; // Prune empty or non-overlapping subtrees
+        }
+        if (isLeaf(node)) {
+            size_t cell = node - FIRST_LEAF;
+            for (int i = 0; i < _leafPointCounts[cell]; ++i) {
+                const Point& p = _leafPoints[cell * CAPACITY + i];
+                if (p.x >= topLeft.x && p.x < topLeft.x + w &&
+                    p.y >= topLeft.y && p.y < topLeft.y + h) {
+                    out.push_back(p);
+                }
+            }
+            return;
+        }
+        for (int q = 0; q < 4; ++q) {
+            queryRangeImpl(childIndex(node, q), childBox(box, q), topLeft, w, h, out);
+        }
+    }
+
+    uint32_t countRangeImpl(size_t node, const Box& box, const Point& topLeft,
+                            int w, int h) const {
+        if (_subtreeCounts[node] == 0 || !boxIntersects(box, topLeft, w, h)) {
+            return 0;
+        }
+        if (boxWithin(box, topLeft, w, h)) {
+            return _subtreeCounts[node]; // Whole subtree inside: O(1)
+        }
+        if (isLeaf(node)) {
+            uint32_t matches = 0;
+            size_t cell = node - FIRST_LEAF;
+            for (int i = 0; i < _leafPointCounts[cell]; ++i) {
+                const Point& p = _leafPoints[cell * CAPACITY + i];
+                if (p.x >= topLeft.x && p.x < topLeft.x + w &&
+                    p.y >= topLeft.y && p.y < topLeft.y + h) {
+                    ++matches;
+                }
+            }
+            return matches;
+        }
+        uint32_t total = 0;
+        for (int q = 0; q < 4; ++q) {
+            total += countRangeImpl(childIndex(node, q), childBox(box, q), topLeft, w, h);
+        }
+        return total;
+    }
+
+    std::vector<uint8_t> _leafPointCounts; // Points stored per leaf cell
+    std::vector<Point> _leafPoints;        // CAPACITY slots per leaf, flat
+    std::vector<uint32_t> _subtreeCounts;  // Per-node point totals
+};
+
+// --- MappedQuadTree Class ---
+// Zero-copy loader for snapshot files produced by
+// FlatQuadTree::saveSnapshot(). The file is mmap'd read-only and the
+// FlatNode array is used directly out of the mapping — no per-node
+// deserialization, so "loading" a multi-million-node tree is just the
+// cost of the map plus page faults on the regions actually touched.
+class MappedQuadTree {
+public:
+    explicit MappedQuadTree(const std::string& path)
+        : _mapping(nullptr), _mappingSize(0), _nodes(nullptr), _nodeCount(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "MappedQuadTree: cannot open " << path << std::endl;
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 ||
+            static_cast<size_t>(st.st_size) < sizeof(FlatQuadTree::SnapshotHeader)) {
+            std::cerr << "MappedQuadTree: " << path << " is not a snapshot" << std::endl;
+            close(fd);
+            return;
+        }
+        void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size),
+                             PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // The mapping keeps the file alive
+        if (mapping == MAP_FAILED) {
+            std::cerr << "MappedQuadTree: mmap failed for " << path << std::endl;
+            return;
+        }
+
+        const FlatQuadTree::SnapshotHeader* header =
+            static_cast<const FlatQuadTree::SnapshotHeader*>(mapping);
+        // The trusted record capacity comes from the mapping size, and
+        // the header's claim is checked against it — never the other way
+        // around. Multiplying the untrusted nodeCount by the record size
+        // would let a crafted count (e.g. 2^63) wrap the product past the
+        // comparison and send the validation loop reading far beyond the
+        // mapping.
+        uint64_t maxNodes = (static_cast<size_t>(st.st_size) - sizeof(*header)) /
+                            sizeof(FlatQuadTree::FlatNode);
+        if (header->magic != FlatQuadTree::SNAPSHOT_MAGIC ||
+            header->version != FlatQuadTree::SNAPSHOT_VERSION ||
+            header->nodeCount > maxNodes) {
+            std::cerr << "MappedQuadTree: " << path
+                      << " has a bad header or truncated data" << std::endl;
+            munmap(mapping, static_cast<size_t>(st.st_size));
+            return;
+        }
+
+        // One sequential pass over the records to validate every child
+        // link before anything traverses them: a sibling group must lie
+        // entirely inside the array, and — since the writer lays nodes
+        // out breadth-first — strictly after its parent, which also rules
+        // out self-references and cycles. Without this, a corrupt or
+        // crafted file with a valid header reads out of bounds or
+        // recurses forever in printTree().
+        const FlatQuadTree::FlatNode* nodes =
+            reinterpret_cast<const FlatQuadTree::FlatNode*>(header + 1);
+        for (uint64_t i = 0; i < header->nodeCount; ++i) {
+            uint32_t firstChild = nodes[i]._firstChild;
+            if (firstChild == FlatQuadTree::NO_CHILD) {
+                continue;
+            }
+            if (firstChild <= i ||
+                static_cast<uint64_t>(firstChild) + 3 >= header->nodeCount) {
+                std::cerr << "MappedQuadTree: " << path
+                          << " has an out-of-range child index" << std::endl;
+                munmap(mapping, static_cast<size_t>(st.st_size));
+                return;
+            }
+        }
+
+        _mapping = mapping;
+        _mappingSize = static_cast<size_t>(st.st_size);
+        _nodes = reinterpret_cast<const FlatQuadTree::FlatNode*>(header + 1);
+        _nodeCount = header->nodeCount;
+    }
+
+    ~MappedQuadTree() {
+        if (_mapping != nullptr) {
+            munmap(_mapping, _mappingSize);
+        }
+    }
+
+    // The mapping is unique; copying would double-unmap.
+    MappedQuadTree(const MappedQuadTree&) = delete;
+    MappedQuadTree& operator=(const MappedQuadTree&) = delete;
+
+    // False if the file was missing, foreign, or truncated.
+    bool valid() const { return _nodes != nullptr; }
+
+    // Number of nodes in the mapped tree.
+    size_t size() const { return _nodeCount; }
+
+    // Direct access to a node record inside the mapping (index 0 = root).
+    // The caller's index must be < size(); child indices read from the
+    // records themselves are safe to follow, since the constructor
+    // validated every link against the array bounds.
+    const FlatQuadTree::FlatNode& node(uint32_t index) const { return _nodes[index]; }
+
+    // Prints the mapped tree, matching FlatQuadTree::printTree() output.
+    void printTree(uint32_t index = 0, int depth = 0) const {
+        if (!valid() || index >= _nodeCount) return;
+        const FlatQuadTree::FlatNode& n = _nodes[index];
+        std::string indent(depth * 4, ' '); // 4 spaces per depth level
+        std::cout << indent << "Node ID: " << n._id
+                  << ", Pos: " << n._pos.toString()
+                  << ", Size: " << n._width << "x" << n._height;
+
+        if (n._firstChild == FlatQuadTree::NO_CHILD) {
+            std::cout << " (Leaf)" << std::endl;
+        } else {
+            std::cout << " (Internal Node)" << std::endl;
+            for (uint32_t c = 0; c < 4; ++c) {
+                printTree(n._firstChild + c, depth + 1);
+            }
+        }
+    }
+
+private:
+    void* _mapping;     // Whole-file mapping (header + records)
+    size_t _mappingSize;
+    const FlatQuadTree::FlatNode* _nodes; // Points into the mapping
+    uint64_t _nodeCount;
+};
+
+// Defined after QuadTree so its static ID counter is available. Refills
+// this pool's private ID range with one shared fetch_add per ID_BLOCK
+// nodes — the only shared-state touch on the pooled construction path.
+template <typename PayloadT>
+inline int BasicNodePool<PayloadT>::takeId() {
+    if (_idsLeft == 0) {
+        _nextLocalId = QuadTree::nextId.fetch_add(ID_BLOCK,
+                                                  std::memory_order_relaxed);
+        _idsLeft = ID_BLOCK;
+    }
+    --_idsLeft;
+    return _nextLocalId++;
+}
+
+// Defined after QuadTree so that sizeof(QuadTree) and placement new are
+// available. Carves one node out of the current block, opening a fresh
+// block when the current one runs dry.
+template <typename PayloadT>
+inline BasicQuadTree<PayloadT>*
+BasicNodePool<PayloadT>::allocate(Point pos, int width, int height) {
+    // The pool tears blocks down without running destructors, so payloads
+    // that own resources cannot live in pooled trees.
+    static_assert(std::is_trivially_destructible<PayloadSlot<PayloadT>>::value,
+                  "pooled trees never run payload destructors");
+    if (!_freeList.empty()) {
+        QuadTree* slot = _freeList.back();
+        _freeList.pop_back();
+        ++_allocatedNodes;
+        return new (slot) QuadTree(pos, width, height, takeId());
+    }
+    if (_blocks.empty() || _usedInBlock == _blockCapacity) {
+        // Round the block up to whole huge pages and let the capacity
+        // grow into the slack; mmap gives naturally aligned, untouched
+        // pages (first touch decides their NUMA node).
+        size_t bytes = (_blockCapacity * sizeof(QuadTree) + HUGE_PAGE_BYTES - 1) &
+                       ~(HUGE_PAGE_BYTES - 1);
+        void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return nullptr; // Out of address space; nothing sane to do
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(memory, bytes, MADV_HUGEPAGE); // Best effort; ENOSYS is fine
+#endif
+        _blockCapacity = bytes / sizeof(QuadTree);
+        _blocks.push_back({static_cast<char*>(memory), bytes});
+        _usedInBlock = 0;
+    }
+    char* slot = _blocks.back().memory + _usedInBlock * sizeof(QuadTree);
+    ++_usedInBlock;
+    ++_allocatedNodes;
+    return new (slot) QuadTree(pos, width, height, takeId());
+}
+
+// --- Raster Export ---
+// Renders the tree's structure straight into a pixel buffer instead of
+// round-tripping through toDotty() and a Graphviz layout run: every
+// node's box is drawn as an outline (occupied leaves get a fill), which
+// is just memory writes. Rendering is parallelized by horizontal bands —
+// each thread walks the tree once and draws only the rows of its band,
+// so no two threads ever touch the same pixels.
+namespace raster {
+
+struct Pixel {
+    uint8_t r, g, b;
+};
+
+// Palette, roughly matching the DOT export's color language.
+const Pixel BACKGROUND = {255, 255, 255};
+const Pixel OUTLINE = {70, 70, 160};     // lightblue's darker cousin
+const Pixel OCCUPIED = {144, 238, 144};  // lightgreen
+
+// Draws the part of the tree that falls inside rows [rowBegin, rowEnd).
+// Coordinates are image-relative (the root's position maps to pixel 0,0).
+inline void renderBand(const QuadTree& tree, std::vector<Pixel>& image,
+                       int imageWidth, int rowBegin, int rowEnd) {
+    int originX = tree._pos.x;
+    int originY = tree._pos.y;
+    tree.visit([&](const QuadTree& node, int) {
+        int left = node._pos.x - originX;
+        int top = node._pos.y - originY;
+        int right = left + node._width - 1;
+        int bottom = top + node._height - 1;
+
+        // Fill occupied leaves first so the outline stays visible.
+        if (node._northWest == nullptr && node._pointCount > 0) {
+            int fillBegin = top > rowBegin ? top : rowBegin;
+            int fillEnd = bottom + 1 < rowEnd ? bottom + 1 : rowEnd;
+            for (int y = fillBegin; y < fillEnd; ++y) {
+                for (int x = left; x <= right; ++x) {
+                    image[static_cast<size_t>(y) * imageWidth + x] = OCCUPIED;
+                }
+            }
+        }
+
+        // Horizontal edges, if their row lies in this band.
+        if (top >= rowBegin && top < rowEnd) {
+            for (int x = left; x <= right; ++x) {
+                image[static_cast<size_t>(top) * imageWidth + x] = OUTLINE;
+            }
+        }
+        if (bottom >= rowBegin && bottom < rowEnd) {
+            for (int x = left; x <= right; ++x) {
+                image[static_cast<size_t>(bottom) * imageWidth + x] = OUTLINE;
+            }
+        }
+
+        // Vertical edges, clipped to the band.
+        int edgeBegin = top > rowBegin ? top : rowBegin;
+        int edgeEnd = bottom + 1 < rowEnd ? bottom + 1 : rowEnd;
+        for (int y = edgeBegin; y < edgeEnd; ++y) {
+            image[static_cast<size_t>(y) * imageWidth + left] = OUTLINE;
+            image[static_cast<size_t>(y) * imageWidth + right] = OUTLINE;
+        }
+    });
+}
+
+/**
+ * @brief Renders the tree's boxes into a binary PPM (P6) image file,
+ * one pixel per world unit.
+ * @param tree The tree to render.
+ * @param path Output file path (conventionally .ppm).
+ * @param threadCount Render threads; 0 means hardware concurrency.
+ * @return true on success, false if the file couldn't be written.
+ */
+inline bool writePPM(const QuadTree& tree, const std::string& path,
+                     unsigned threadCount = 0) {
+    int imageWidth = tree._width;
+    int imageHeight = tree._height;
+    std::vector<Pixel> image(static_cast<size_t>(imageWidth) * imageHeight, BACKGROUND);
+
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if (threadCount == 0) {
+        threadCount = 4;
+    }
+    if (threadCount > static_cast<unsigned>(imageHeight)) {
+        threadCount = static_cast<unsigned>(imageHeight);
+    }
+
+    // One horizontal band per thread; bands partition the rows, so the
+    // writes are disjoint by construction.
+    std::vector<std::thread> workers;
+    int rowsPerBand = (imageHeight + static_cast<int>(threadCount) - 1) /
+                      static_cast<int>(threadCount);
+    for (unsigned t = 0; t < threadCount; ++t) {
+        int rowBegin = static_cast<int>(t) * rowsPerBand;
+        int rowEnd = rowBegin + rowsPerBand < imageHeight ? rowBegin + rowsPerBand
+                                                          : imageHeight;
+        workers.emplace_back(renderBand, std::cref(tree), std::ref(image),
+                             imageWidth, rowBegin, rowEnd);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "raster::writePPM: cannot open " << path << std::endl;
+        return false;
+    }
+    out << "P6\n" << imageWidth << " " << imageHeight << "\n255\n";
+    out.write(reinterpret_cast<const char*>(image.data()),
+              static_cast<std::streamsize>(image.size() * sizeof(Pixel)));
+    return static_cast<bool>(out);
+}
+
+} // namespace raster
+
+// --- Benchmark Harness ---
+// Hand-rolled timing for the three paths that matter: building via
+// subdivide(), full traversal (the printTree() recursion pattern minus
+// the I/O), and DOT export. Run with `--bench`. Results are ns/node so
+// regressions show up independently of region size; peak RSS is printed
+// at the end via getrusage.
+namespace bench {
+
+// Discards everything written to it; used to time export without disk
+// effects.
+struct NullBuffer : std::streambuf {
+    int overflow(int c) override { return c; }
+};
+
+// Counts every node via the shared visit() traversal engine (the same
+// machinery printTree() and toDotty() run on).
+size_t countNodes(const QuadTree* node) {
+    size_t count = 0;
+    node->visit([&count](const QuadTree&, int) { ++count; });
+    return count;
+}
+
+// Nanoseconds elapsed while running fn().
+template <typename Fn>
+double timeNs(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto stop = std::chrono::steady_clock::now();
+    return static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+}
+
+// Times build, traversal, and export for one square region size. The
+// trace facility is silent at its default level, so nothing here fights
+// the console for time.
+void runRegion(int size) {
+    NullBuffer nullBuffer;
+    NodePool pool;
+    QuadTree* root = pool.allocate(Point(0, 0), size, size);
+    double buildNs = timeNs([&] { root->subdivide(&pool); });
+    size_t nodes = pool.allocatedNodes();
+
+    size_t visited = 0;
+    double traverseNs = timeNs([&] { visited = countNodes(root); });
+
+    std::ostream nullStream(&nullBuffer);
+    double exportNs = timeNs([&] { root->toDotty(nullStream); });
+
+    std::cout << "  region " << size << "x" << size
+              << ": nodes=" << nodes
+              << ", build=" << buildNs / 1e6 << " ms (" << buildNs / nodes << " ns/node)"
+              << ", traverse=" << traverseNs / visited << " ns/node"
+              << ", export=" << exportNs / nodes << " ns/node"
+              << std::endl;
+}
+
+// Times the batch quadrant classifier, vector path against the scalar
+// loop, and cross-checks that they agree.
+void runClassify() {
+    const size_t count = 1 << 22; // 4M points
+    std::vector<int32_t> x(count), y(count);
+    uint32_t seed = 12345; // Small LCG; distribution doesn't matter here
+    for (size_t i = 0; i < count; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        x[i] = static_cast<int32_t>(seed % 8192);
+        seed = seed * 1664525u + 1013904223u;
+        y[i] = static_cast<int32_t>(seed % 8192);
+    }
+
+    std::vector<uint8_t> vectorOut(count), scalarOut(count);
+    double vectorNs = timeNs([&] {
+        simd::classifyQuadrants(x.data(), y.data(), count, 4096, 4096, vectorOut.data());
+    });
+    double scalarNs = timeNs([&] {
+        simd::classifyQuadrantsScalar(x.data(), y.data(), count, 4096, 4096, scalarOut.data());
+    });
+    bool match = vectorOut == scalarOut;
+    std::cout << "  classify " << count << " points: vector="
+              << vectorNs / count << " ns/pt, scalar=" << scalarNs / count
+              << " ns/pt" << (match ? "" : " (MISMATCH!)") << std::endl;
+}
+
+// Entry point for `--bench`.
+void runAll() {
+    std::cout << "--- QuadTree Benchmarks ---\n";
+    const int regionSizes[] = {256, 1024, 4096};
+    for (int size : regionSizes) {
+        runRegion(size);
+    }
+    runClassify();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cout << "  peak RSS: " << usage.ru_maxrss << " KB\n";
+    std::cout << "---------------------------\n";
+}
+
+} // namespace bench
+
+// --- Ingestion Pipeline ---
+// The production front door, replacing the parse-CSV-and-loop-insert
+// glue: memory-map a binary point file (raw little-endian int32 x,y
+// pairs, nothing else), bulk-build a tree over the mapping in parallel,
+// and flatten it for the query engine. The mapping is MAP_PRIVATE, so
+// the build's in-place partitioning dirties copy-on-write pages instead
+// of the file — the points are never copied into an intermediate vector.
+// Run with `--pipeline <file>`; per-stage wall times are printed in the
+// benchmark harness's register.
+namespace pipeline {
+
+// Executes the full pipeline over `path`. Returns false (with a message
+// on std::cerr) if the file can't be mapped or isn't a point file.
+bool run(const std::string& path) {
+    std::cout << "--- Ingestion pipeline: " << path << " ---\n";
+
+    // Stage 1: map the file. No read() into a buffer — the build stages
+    // fault pages in as they touch them.
+    int fd = -1;
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    double mapNs = bench::timeNs([&] {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            return;
+        }
+        mapping = mmap(nullptr, static_cast<size_t>(info.st_size),
+                       PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    });
+    if (fd >= 0) {
+        close(fd); // The mapping keeps its own reference
+    }
+    if (mapping == MAP_FAILED) {
+        std::cerr << "pipeline: cannot map " << path << std::endl;
+        return false;
+    }
+    size_t bytes = static_cast<size_t>(info.st_size);
+    size_t count = bytes / sizeof(Point);
+    if (count == 0 || bytes % sizeof(Point) != 0) {
+        std::cerr << "pipeline: " << path << " is not a point file" << std::endl;
+        munmap(mapping, bytes);
+        return false;
+    }
+    Point* points = static_cast<Point*>(mapping);
+
+    // Stage 2: one sequential pass for the bounding box, which seeds the
+    // root region (and prefaults the mapping ahead of the build).
+    int minX = points[0].x, maxX = points[0].x;
+    int minY = points[0].y, maxY = points[0].y;
+    double scanNs = bench::timeNs([&] {
+        for (size_t i = 1; i < count; ++i) {
+            minX = std::min(minX, points[i].x);
+            maxX = std::max(maxX, points[i].x);
+            minY = std::min(minY, points[i].y);
+            maxY = std::max(maxY, points[i].y);
+        }
+    });
+
+    // Stage 3: parallel bulk build straight over the mapping. Workers
+    // SIMD-classify and permute their runs in place (dirtying private
+    // pages), then bulk-load the quadrant runs into their own pools.
+    ParallelBuilder builder;
+    QuadTree* root = nullptr;
+    size_t dropped = 0;
+    double buildNs = bench::timeNs([&] {
+        root = builder.buildFrom(points, count, Point(minX, minY),
+                                 maxX - minX + 1, maxY - minY + 1, &dropped);
+    });
+    if (dropped != 0) {
+        // Data too dense for the subdivision floor: the tree is usable
+        // but incomplete, which the caller must not find out from query
+        // results alone.
+        std::cerr << "pipeline: dropped " << dropped << " of " << count
+                  << " points overflowing minimum-size leaves" << std::endl;
+    }
+
+    // Stage 4: flatten for the query engine.
+    std::unique_ptr<FlatQuadTree> flat;
+    double flattenNs = bench::timeNs([&] {
+        flat.reset(new FlatQuadTree(root));
+    });
+
+    std::cout << "  tree: " << flat->size() << " nodes, "
+              << root->countRange(Point(minX, minY),
+                                  maxX - minX + 1, maxY - minY + 1)
+              << " of " << count << " points stored" << std::endl;
+
+    std::cout << "  map=" << mapNs / 1e6 << " ms"
+              << ", scan=" << scanNs / 1e6 << " ms"
+              << ", build=" << buildNs / 1e6 << " ms ("
+              << buildNs / count << " ns/pt)"
+              << ", flatten=" << flattenNs / 1e6 << " ms" << std::endl;
+    counters::report(std::cout);
+    std::cout << "------------------------------------\n";
+
+    munmap(mapping, bytes);
+    return true;
+}
+
+} // namespace pipeline
+
+// --- Main Function ---
+int main(int argc, char** argv) {
+    // `--bench` runs the timing suite instead of the demo; `--pipeline
+    // <file>` ingests a binary point file instead of the demo; `--verbose`
+    // (and `-v`) raises the trace level for the demo run.
+    bool runBench = false;
+    std::string pipelinePath;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bench") == 0) {
+            runBench = true;
+        } else if (std::strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+            pipelinePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--verbose") == 0) {
+            trace::level = 2;
+        } else if (std::strcmp(argv[i], "-v") == 0) {
+            trace::level = 1;
+        }
+    }
+    if (runBench) {
+        bench::runAll();
+        return 0;
+    }
+    if (!pipelinePath.empty()) {
+        return pipeline::run(pipelinePath) ? 0 : 1;
+    }
+
+    // Create the root of the QuadTree with initial height and width 100x100
+    // The position (0,0) represents the top-left corner of the entire region.
+    // All nodes (root included) are drawn from an arena pool, so the whole
+    // tree is a few large allocations instead of one `new` per node.
+    NodePool pool;
+    QuadTree* root = pool.allocate(Point(0, 0), 100, 100);
+
+    // Start the subdivision process from the root
+    root->subdivide(&pool);
+
+    std::cout << "\n--- QuadTree Structure (Console Print) ---\n";
+    //root->printTree();
+    std::cout << "------------------------------------------\n";
+
+    // Generate and print the Dotty code, streamed straight to stdout so
+    // no in-memory copy of the document is ever built.
+    std::cout << "\n--- QuadTree Dotty Code (Graphviz) ---\n";
+    root->toDotty(std::cout);
+    std::cout << "--------------------------------------\n";
+
+    // To visualize this:
+    // 1. Save the output of the "--- QuadTree Dotty Code ---" block to a file, e.g., quadtree.dot
+    // 2. Install Graphviz (if you haven't already): https://graphviz.org/download/
+    // 3. Run the dot command in your terminal:
     //    dot -Tpng quadtree.dot -o quadtree.png
     // 4. Open quadtree.png to see the visualization.
 
 
-    // Clean up the memory allocated for the QuadTree
-    // The destructor will recursively delete all child nodes.
-    delete root;
-    root = nullptr; // Good practice to nullify pointer after deletion
+    // --- Adaptive insertion demo ---
+    // A second tree built purely from data: leaves split only when they
+    // overflow their inline capacity, so node count tracks point count
+    // instead of region area.
+    QuadTree* adaptive = pool.allocate(Point(0, 0), 100, 100);
+    Point samples[] = { Point(5, 5), Point(8, 12), Point(30, 40),
+                        Point(31, 41), Point(32, 42), Point(90, 90) };
+    for (const Point& p : samples) {
+        adaptive->insert(p, &pool);
+    }
+    std::cout << "\n--- Adaptive QuadTree (capacity " << QuadTree::CAPACITY
+              << " per leaf) ---\n";
+    adaptive->printTree();
+    std::cout << "------------------------------------------\n";
+
+    // --- Incremental update demo ---
+    // A dirty 20x20 patch rebuilds only the quadrants it touches; the
+    // discarded pooled nodes are recycled into the arena.
+    adaptive->update(Point(25, 25), 20, 20, &pool);
+    std::cout << "\n--- After update of patch (25,25) 20x20 ---\n";
+    adaptive->printTree();
+    std::cout << "-------------------------------------------\n";
+
+    // --- Bulk-load demo ---
+    // Same data as the adaptive tree, built in one partitioning pass
+    // over the array instead of one root-to-leaf walk per point.
+    std::vector<Point> bulkPoints(std::begin(samples), std::end(samples));
+    QuadTree* bulk = QuadTree::bulkLoad(bulkPoints.data(), bulkPoints.size(),
+                                        Point(0, 0), 100, 100, pool);
+    std::cout << "\n--- Bulk-loaded QuadTree ---\n";
+    bulk->printTree();
+    std::cout << "----------------------------\n";
+
+    // --- Range query demo ---
+    // The result buffer is owned by the caller and reused across queries.
+    std::vector<Point> results;
+    adaptive->queryRange(Point(25, 25), 20, 20, results);
+    std::cout << "\n--- Range query (25,25) 20x20 ---\n";
+    for (const Point& p : results) {
+        std::cout << "  Hit: " << p.toString() << std::endl;
+    }
+    // Counting the same rectangle uses the maintained subtree aggregates
+    // — covered subtrees answer in O(1) without touching their leaves.
+    std::cout << "countRange agrees: " << adaptive->countRange(Point(25, 25), 20, 20)
+              << " points; whole region holds "
+              << adaptive->countRange(Point(0, 0), 100, 100) << std::endl;
+    results.clear();
+    adaptive->queryRadius(Point(6, 6), 10, results);
+    std::cout << "--- Radius query center (6,6) r=10 ---\n";
+    for (const Point& p : results) {
+        std::cout << "  Hit: " << p.toString() << std::endl;
+    }
+    // Hot-tile queries served from the memoizing cache; an update through
+    // the cache evicts only the overlapping entry.
+    {
+        QueryCache cache(*adaptive);
+        std::vector<Point> cached;
+        for (int i = 0; i < 5; ++i) {
+            cached.clear();
+            cache.queryRange(Point(25, 25), 20, 20, cached);
+        }
+        cache.update(Point(25, 25), 20, 20, &pool); // Evicts the hot entry
+        cached.clear();
+        cache.queryRange(Point(25, 25), 20, 20, cached);
+        std::cout << "--- Query cache: " << cache.hits() << " hits, "
+                  << cache.misses() << " misses (expected 4/2) ---\n";
+    }
+
+    // A burst of rectangles resolved in one shared traversal.
+    std::vector<QuadTree::QueryRect> burst = {
+        {Point(0, 0), 10, 15}, {Point(85, 85), 10, 10}, {Point(28, 38), 6, 6}
+    };
+    std::vector<std::vector<Point>> burstResults;
+    adaptive->queryRangeBatch(burst, burstResults);
+    std::cout << "--- Batched queries (" << burst.size() << " rects) ---\n";
+    for (size_t q = 0; q < burstResults.size(); ++q) {
+        std::cout << "  query " << q << ": " << burstResults[q].size()
+                  << " hits" << std::endl;
+    }
+    results.clear();
+    LinearQuadTree linear(samples, sizeof(samples) / sizeof(samples[0]));
+    linear.queryRange(Point(25, 25), 20, 20, results);
+    std::cout << "--- Same query, Morton linear quadtree ("
+              << linear.memoryBytes() << " bytes) ---\n";
+    for (const Point& p : results) {
+        std::cout << "  Hit: " << p.toString() << std::endl;
+    }
+    results.clear();
+    adaptive->nearest(Point(33, 43), 2, results);
+    std::cout << "--- 2 nearest neighbors of (33,43) ---\n";
+    for (const Point& p : results) {
+        std::cout << "  Hit: " << p.toString() << std::endl;
+    }
+    std::cout << "------------------------------------------\n";
+
+    // Build the cache-friendly flat-array layout from the pointer tree.
+    // Queries and traversals that matter for performance should run over
+    // this representation.
+    FlatQuadTree flat(root);
+    std::cout << "\n--- FlatQuadTree ---\n";
+    std::cout << "Flat layout holds " << flat.size() << " nodes in "
+              << flat.size() * sizeof(FlatQuadTree::FlatNode)
+              << " contiguous bytes." << std::endl;
+    std::cout << "--------------------\n";
+
+    // --- Inline payload demo ---
+    // A tree instantiated with a per-region payload: here a population
+    // count per quadrant. The data lives inside the node (and inside the
+    // FlatNode when flattened) — no side table keyed on node IDs.
+    std::cout << "\n--- Inline payloads (BasicQuadTree<uint32_t>) ---\n";
+    BasicQuadTree<uint32_t> tagged(Point(0, 0), 100, 100);
+    tagged.subdivide();
+    tagged._northWest->payload() = 12;
+    tagged._southEast->payload() = 47;
+    BasicFlatQuadTree<uint32_t> taggedFlat(&tagged);
+    std::cout << "NW population " << tagged._northWest->payload()
+              << ", SE population " << tagged._southEast->payload()
+              << " (flat copy agrees: "
+              << taggedFlat.node(taggedFlat.node(0)._firstChild)._payload
+              << ")" << std::endl;
+    std::cout << "Node size: " << sizeof(QuadTree) << " bytes payload-free, "
+              << sizeof(BasicQuadTree<uint32_t>) << " with the tag inline."
+              << std::endl;
+    std::cout << "-------------------------------------------------\n";
+
+    // --- Raster export demo ---
+    // Direct-to-bitmap rendering of the adaptive tree; milliseconds of
+    // memory writes instead of a Graphviz layout run.
+    if (raster::writePPM(*adaptive, "quadtree.ppm")) {
+        std::cout << "\nWrote raster visualization to quadtree.ppm\n";
+    }
+
+    // --- Statistics demo ---
+    std::cout << "\n--- Tree statistics (adaptive tree) ---\n";
+    adaptive->stats().print(std::cout);
+    counters::report(std::cout);
+    std::cout << "---------------------------------------\n";
+
+    // --- Lazy subdivision demo ---
+    // Marking a large region lazy costs one node; the first query
+    // materializes only the quadrants it actually touches.
+    {
+        QuadTree* lazyRoot = pool.allocate(Point(0, 0), 1024, 1024);
+        lazyRoot->subdivideLazy(&pool);
+        size_t beforeNodes = lazyRoot->stats().nodeCount;
+        std::vector<Point> scratch;
+        lazyRoot->queryRange(Point(0, 0), 10, 10, scratch);
+        // Node count of an eager build of the same region, for contrast:
+        // every level above the MIN_SIZE floor subdivides fully.
+        size_t fullNodes = 0;
+        size_t levelNodes = 1;
+        for (int side = 1024; ; side /= 2) {
+            fullNodes += levelNodes;
+            if (side <= QuadTree::MIN_SIZE) {
+                break;
+            }
+            levelNodes *= 4;
+        }
+        std::cout << "\n--- Lazy subdivision (1024x1024) ---\n";
+        std::cout << "Nodes before first query: " << beforeNodes
+                  << ", after one 10x10 corner query: "
+                  << lazyRoot->stats().nodeCount
+                  << " (full build would be " << fullNodes << ")." << std::endl;
+        std::cout << "------------------------------------\n";
+    }
+
+    // --- Compile-time specialized tree demo ---
+    // Power-of-two regions get an implicit-heap tree: no child pointers,
+    // geometry recomputed from the template parameters.
+    {
+        StaticQuadTree<256> staticTree;
+        for (const Point& p : samples) {
+            staticTree.insert(p);
+        }
+        std::cout << "\n--- StaticQuadTree<256> ---\n";
+        std::cout << "depth=" << StaticQuadTree<256>::DEPTH
+                  << ", nodes=" << StaticQuadTree<256>::NODE_COUNT
+                  << ", leaf=" << StaticQuadTree<256>::LEAF_SIZE << "x"
+                  << StaticQuadTree<256>::LEAF_SIZE
+                  << " (all compile-time constants)" << std::endl;
+        std::cout << "points in (25,25) 20x20: "
+                  << staticTree.countRange(Point(25, 25), 20, 20) << std::endl;
+        std::cout << "---------------------------\n";
+    }
+
+    // --- Binary snapshot demo ---
+    // Save the flat tree in one sequential write, then mmap it back and
+    // use the node records straight out of the mapping.
+    const std::string snapshotPath = "quadtree.snapshot";
+    if (flat.saveSnapshot(snapshotPath)) {
+        MappedQuadTree mapped(snapshotPath);
+        std::cout << "\n--- Snapshot round-trip ---\n";
+        if (mapped.valid()) {
+            std::cout << "Mapped " << mapped.size() << " nodes from "
+                      << snapshotPath << " (root ID "
+                      << mapped.node(0)._id << ")." << std::endl;
+        }
+        std::cout << "---------------------------\n";
+    }
+
+    // --- Compact archive demo ---
+    // The archival format stores topology bits and leaf points only;
+    // boxes and IDs are recomputed on load. Round-trip the adaptive tree
+    // and compare file sizes against the FlatNode snapshot.
+    const std::string archivePath = "quadtree.qta";
+    if (adaptive->saveCompact(archivePath)) {
+        std::cout << "\n--- Compact archive round-trip ---\n";
+        QuadTree* restored = QuadTree::loadCompact(archivePath, pool);
+        if (restored != nullptr) {
+            struct stat archInfo;
+            size_t snapshotBytes = sizeof(FlatQuadTree::SnapshotHeader) +
+                                   FlatQuadTree(adaptive).size() *
+                                       sizeof(FlatQuadTree::FlatNode);
+            if (stat(archivePath.c_str(), &archInfo) == 0) {
+                std::cout << "Archive is " << archInfo.st_size
+                          << " bytes; a flat snapshot of the same tree is "
+                          << snapshotBytes << "." << std::endl;
+            }
+            std::cout << "Restored tree holds "
+                      << restored->countRange(Point(0, 0), 100, 100)
+                      << " points (source holds "
+                      << adaptive->countRange(Point(0, 0), 100, 100)
+                      << ")." << std::endl;
+        }
+        std::cout << "----------------------------------\n";
+    }
+
+    // --- Concurrent refresh demo ---
+    // Two readers query lock-free while the writer repeatedly swaps in a
+    // rebuilt NW subtree; replaced subtrees go through the epoch
+    // reclaimer instead of being deleted under the readers' feet.
+    {
+        NodePool sharedPool;
+        EpochReclaimer reclaimer;
+        QuadTree* sharedRoot = sharedPool.allocate(Point(0, 0), 100, 100);
+        for (const Point& p : samples) {
+            sharedRoot->insert(p, &sharedPool);
+        }
+
+        const int queriesPerReader = 2000;
+        std::atomic<int> activeReaders{2};
+        std::atomic<size_t> reads{0};
+        auto readerFn = [&] {
+            std::vector<Point> buffer;
+            for (int i = 0; i < queriesPerReader; ++i) {
+                EpochReclaimer::ReadGuard guard(reclaimer);
+                buffer.clear();
+                sharedRoot->queryRangeShared(Point(0, 0), 100, 100, buffer);
+                ++reads;
+            }
+            --activeReaders;
+        };
+        std::thread reader1(readerFn), reader2(readerFn);
+
+        // Keep refreshing the NW quadrant for as long as the readers are
+        // querying, so the swaps really overlap the reads.
+        size_t refreshes = 0;
+        while (activeReaders.load() > 0) {
+            // Build the replacement fully before publishing it.
+            QuadTree* replacement = sharedPool.allocate(Point(0, 0), 50, 50);
+            replacement->insert(Point(5, 5), &sharedPool);
+            replacement->insert(Point(8, 12), &sharedPool);
+            QuadTree* old = sharedRoot->publishChild(QuadTree::NORTH_WEST, replacement);
+            reclaimer.retire(old, &sharedPool);
+            reclaimer.collect();
+            ++refreshes;
+        }
+        reader1.join();
+        reader2.join();
+
+        std::cout << "\n--- Concurrent refresh ---\n";
+        std::cout << "Readers completed " << reads.load()
+                  << " lock-free queries across " << refreshes
+                  << " subtree refreshes ("
+                  << reclaimer.reclaimedCount() << " subtrees reclaimed)."
+                  << std::endl;
+        std::cout << "--------------------------\n";
+    }
+
+    // --- Compaction demo ---
+    // The eagerly subdivided demo tree is entirely empty, so the region
+    // merge collapses all of it back into the root.
+    {
+        TreeStats before = root->stats();
+        size_t removed = root->compact(&pool);
+        std::cout << "\n--- Compaction ---\n";
+        std::cout << "Removed " << removed << " of " << before.nodeCount
+                  << " nodes; " << root->stats().nodeCount << " remain."
+                  << std::endl;
+        std::cout << "------------------\n";
+    }
+
+    // --- Parallel build demo ---
+    // Quadrants fan out to a worker pool; each worker allocates from its
+    // own arena so the build scales without a lock on the allocator.
+    {
+        ParallelBuilder builder;
+        QuadTree* parallelRoot = builder.allocateRoot(Point(0, 0), 300, 300);
+        builder.build(parallelRoot);
+        std::cout << "\n--- Parallel build (300x300) ---\n";
+        std::cout << "Built tree rooted at node " << parallelRoot->_id
+                  << " across worker threads." << std::endl;
+        std::cout << "--------------------------------\n";
+    } // Builder teardown reclaims all worker pools at once
+
+    // No per-node cleanup needed: the pool reclaims every node's storage
+    // in one sweep when it goes out of scope.
+    root = nullptr; // Good practice to nullify pointer once the tree is done
 
     return 0;
 }